@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <SDL2/SDL.h>
+
+#include <SDL2pp/SDL2pp.hh>
+
+#include <dat/datfile.hh>
+#include <graphics/spritemanager.hh>
+
+#include <graphics/camera.hh>
+#include <graphics/groundrenderer.hh>
+#include <graphics/objectsorter.hh>
+#include <graphics/renderer.hh>
+#include <game/game.hh>
+#include <game/levelloader.hh>
+#include <gameobjects/heli.hh>
+
+// Counts heap allocations made by the whole program
+static std::atomic<size_t> num_allocations(0);
+
+void* operator new(size_t size) {
+	num_allocations++;
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+// Timings and allocation counts of single stage of frame pipeline
+class Stage {
+protected:
+	std::string name_;
+	std::vector<double> times_; // us
+	size_t allocations_;
+
+public:
+	Stage(const std::string& name) : name_(name), allocations_(0) {
+	}
+
+	template<class F>
+	void Run(F func, bool measure) {
+		size_t allocations_before = num_allocations;
+		auto start = std::chrono::steady_clock::now();
+
+		func();
+
+		auto end = std::chrono::steady_clock::now();
+		if (measure) {
+			times_.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+			allocations_ += num_allocations - allocations_before;
+		}
+	}
+
+	double GetPercentile(double percentile) const {
+		if (times_.empty())
+			return 0.0;
+
+		std::vector<double> sorted = times_;
+		std::sort(sorted.begin(), sorted.end());
+		return sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * percentile))];
+	}
+
+	void Report(std::ostream& stream) const {
+		stream << std::setw(8) << name_
+		       << std::setw(12) << GetPercentile(0.5)
+		       << std::setw(12) << GetPercentile(0.99)
+		       << std::setw(14) << (times_.empty() ? 0.0 : (double)allocations_ / times_.size())
+		       << std::endl;
+	}
+};
+
+// Heli control flags for given frame: flies forward, turning
+// left and right in turns, with guns and rockets firing
+int GetScriptedControls(int frame) {
+	int flags = Heli::FORWARD | Heli::GUN;
+
+	switch (frame / 90 % 3) {
+	case 1: flags |= Heli::LEFT; break;
+	case 2: flags |= Heli::RIGHT; break;
+	}
+
+	if (frame % 120 < 30)
+		flags |= Heli::HYDRA;
+	if (frame % 180 == 0)
+		flags |= Heli::HELLFIRE;
+
+	return flags;
+}
+
+void usage(const char* progname) {
+	std::cerr << "Usage: " << progname << " <filename.dat> [frames]" << std::endl;
+}
+
+int realmain(int argc, char** argv) {
+	if (argc < 2 || argc > 3) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	static const int warmup_frames = 10;
+	static const unsigned int frame_ms = 16;
+
+	int frames = (argc == 3) ? std::atoi(argv[2]) : 1000;
+
+	// no display or GPU is required
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	DatFile datfile(argv[1], DatFile::MMAP);
+
+	SDL2pp::SDL sdl(SDL_INIT_VIDEO);
+	SDL2pp::Window window("OpenStrike benchmark", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, 320, 200, 0);
+	SDL2pp::Renderer renderer(window, -1, SDL_RENDERER_SOFTWARE);
+
+	renderer.SetDrawBlendMode(SDL_BLENDMODE_BLEND);
+
+	// same setup as the game itself
+	SpriteManager spriteman(renderer, datfile);
+
+	Renderer game_renderer(spriteman);
+	GroundRenderer ground_renderer(renderer);
+
+	Camera camera(Vector3f(0, 0, 0), SDL2pp::Rect(0, 0, 320, 200));
+
+	LevelLoader level_loader;
+	game_renderer.SubscribeToLoader(level_loader);
+
+	Game game = level_loader.Load(datfile, "LEVEL0", 12, 6);
+	Heli* heli = game.Spawn<Heli>(Vector2f(512 * 3 + 256, 1024 * 1 + 256));
+
+	spriteman.LoadAll();
+
+	ObjectSorter sorter;
+	Visitor null_visitor;
+
+	Stage update("update"), sort("sort"), ground("ground"), objects("objects"), present("present");
+
+	auto start = std::chrono::steady_clock::now();
+	for (int frame = 0; frame < warmup_frames + frames; frame++) {
+		bool measure = frame >= warmup_frames;
+		if (frame == warmup_frames)
+			start = std::chrono::steady_clock::now();
+
+		heli->RemoveControlFlags(~0);
+		heli->AddControlFlags(GetScriptedControls(frame));
+
+		update.Run([&]() {
+			game.Update(frame_ms);
+			camera.SetTarget(heli->GetPos().Grounded() + Vector3f(120, 0, 0));
+		}, measure);
+
+		// Renderer::Render() sorts objects itself; sorting is also
+		// measured standalone to see its share of object rendering
+		sort.Run([&]() {
+			sorter.Clear();
+			game.Accept(sorter);
+			sorter.Accept(null_visitor);
+		}, measure);
+
+		ground.Run([&]() {
+			renderer.SetDrawColor(0, 0, 0);
+			renderer.Clear();
+			ground_renderer.Render(game, camera);
+		}, measure);
+
+		objects.Run([&]() {
+			game_renderer.Render(game, camera);
+		}, measure);
+
+		present.Run([&]() {
+			renderer.Present();
+		}, measure);
+	}
+	double total = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cout << std::fixed << std::setprecision(1);
+	std::cout << std::setw(8) << "stage" << std::setw(12) << "p50, us" << std::setw(12) << "p99, us" << std::setw(14) << "allocs/frame" << std::endl;
+	update.Report(std::cout);
+	sort.Report(std::cout);
+	ground.Report(std::cout);
+	objects.Report(std::cout);
+	present.Report(std::cout);
+	std::cout << frames << " frames in " << total << " s, " << frames / total << " fps" << std::endl;
+
+	std::cout << spriteman.GetNumAtlasPages() << " atlas pages, occupancy:";
+	for (unsigned int page = 0; page < spriteman.GetNumAtlasPages(); page++)
+		std::cout << " " << spriteman.GetAtlasOccupancy(page) * 100.0f << "%";
+	std::cout << std::endl;
+
+	return 0;
+}
+
+int main(int argc, char** argv) {
+	try {
+		return realmain(argc, argv);
+	} catch (SDL2pp::Exception& e) {
+		std::cerr << "Error: " << e.what() << " (" << e.GetSDLError() << ")" << std::endl;
+	} catch (std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+	}
+
+	return 1;
+}
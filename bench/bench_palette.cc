@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+
+#include <dat/buffer.hh>
+#include <dat/datfile.hh>
+#include <dat/datgraphics.hh>
+
+// Gives access to sprite data and contains the original
+// per-byte expansion loop, for comparison
+class ReferenceGraphics : public DatGraphics {
+public:
+	ReferenceGraphics(const MemRange& data) : DatGraphics(data) {
+	}
+
+	std::vector<unsigned char> GetPixelsReference(unsigned int num) const {
+		Sprite sprite = GetSprite(num);
+		const std::vector<Color>& palette = GetPalette();
+
+		size_t pixels_size = sprite.width * sprite.height * 4;
+
+		std::vector<unsigned char> pixels(pixels_size, 0);
+
+		const Slice& data = sprite.data;
+
+		size_t data_pos = 0;
+		size_t out_pos = 0;
+		size_t pixel_in_line = 0;
+		unsigned char mask;
+		size_t width = sprite.width;
+
+		if (transparency_) {
+			while (data_pos < data.GetSize() && out_pos + 4 <= pixels_size) {
+				mask = data[data_pos++];
+
+				for (int j = 0; j < 8 && pixel_in_line < width && data_pos < data.GetSize() && out_pos + 4 <= pixels_size; j++, pixel_in_line++) {
+					if (mask & (0x80 >> j)) {
+						unsigned char color = data[data_pos++];
+						if (color >= palette.size())
+							throw std::logic_error("color not found in the palette");
+
+						pixels[out_pos++] = palette[color].blue;
+						pixels[out_pos++] = palette[color].green;
+						pixels[out_pos++] = palette[color].red;
+						pixels[out_pos++] = 255;
+					} else {
+						pixels[out_pos++] = 0;
+						pixels[out_pos++] = 0;
+						pixels[out_pos++] = 0;
+						pixels[out_pos++] = 0;
+					}
+				}
+
+				if (pixel_in_line == width)
+					pixel_in_line = 0;
+			}
+		} else {
+			for (; data_pos < data.GetSize() && out_pos + 4 <= pixels_size; ) {
+				unsigned char color = data[data_pos++];
+				if (color >= palette.size())
+					throw std::logic_error("color not found in the palette");
+
+				pixels[out_pos++] = palette[color].blue;
+				pixels[out_pos++] = palette[color].green;
+				pixels[out_pos++] = palette[color].red;
+				pixels[out_pos++] = 255;
+			}
+		}
+
+		return pixels;
+	}
+};
+
+static void AppendWord(Buffer& buffer, uint16_t value) {
+	buffer.Append(value & 0xff);
+	buffer.Append(value >> 8);
+}
+
+static void AppendDWord(Buffer& buffer, uint32_t value) {
+	AppendWord(buffer, value & 0xffff);
+	AppendWord(buffer, value >> 16);
+}
+
+static void AppendString(Buffer& buffer, const std::string& string) {
+	buffer.Append(reinterpret_cast<const unsigned char*>(string.data()), string.size());
+}
+
+// Builds graphics resource with random sprites
+Buffer MakeGraphics(bool transparent, int num_sprites, int width, int height) {
+	Buffer sprites_data;
+	std::vector<uint32_t> offsets;
+
+	for (int i = 0; i < num_sprites; i++) {
+		offsets.push_back(sprites_data.GetSize());
+
+		for (int y = 0; y < height; y++) {
+			for (int x = 0; x < width; x++) {
+				if (transparent && x % 8 == 0) {
+					unsigned char mask = std::rand() & 0xff;
+					sprites_data.Append(mask);
+					for (int j = 0; j < 8 && x + j < width; j++)
+						if (mask & (0x80 >> j))
+							sprites_data.Append(std::rand() % 200);
+				} else if (!transparent) {
+					sprites_data.Append(std::rand() % 200);
+				}
+			}
+		}
+	}
+
+	size_t sprites_header_size = 16 + num_sprites * 16;
+
+	Buffer sprites;
+	AppendString(sprites, "SPRITES ");
+	AppendWord(sprites, num_sprites);
+	AppendWord(sprites, 0);
+	AppendDWord(sprites, 0);
+	for (int i = 0; i < num_sprites; i++) {
+		AppendWord(sprites, width);
+		AppendWord(sprites, height);
+		AppendWord(sprites, 0);
+		AppendWord(sprites, 0);
+		AppendWord(sprites, width);
+		AppendWord(sprites, height);
+		AppendDWord(sprites, sprites_header_size + offsets[i]);
+	}
+	sprites.Append(sprites_data.GetData(), sprites_data.GetSize());
+
+	Buffer graphics;
+	AppendString(graphics, "GRAPHICS");
+	AppendWord(graphics, 0);
+	graphics.Append(transparent ? 1 : 0);
+	graphics.Append(0);
+	AppendDWord(graphics, sprites.GetSize());
+	graphics.Append((unsigned char)0, 16);
+	graphics.Append(sprites.GetData(), sprites.GetSize());
+
+	AppendString(graphics, "PALETTE ");
+	AppendWord(graphics, 200);
+	graphics.Append((unsigned char)0, 22);
+	for (int i = 0; i < 200 * 3; i++)
+		graphics.Append(std::rand() & 0x3f);
+
+	return graphics;
+}
+
+template<class Fn>
+double Measure(const Fn& fn, int iterations) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < iterations; i++)
+		fn();
+	return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+void usage(const char* progname) {
+	std::cerr << "Usage: " << progname << " [iterations]" << std::endl;
+}
+
+int realmain(int argc, char** argv) {
+	if (argc > 2) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	int iterations = (argc == 2) ? std::atoi(argv[1]) : 20;
+	int failures = 0;
+
+	for (bool transparent : { false, true }) {
+		Buffer data = MakeGraphics(transparent, 64, 61, 45);
+		ReferenceGraphics graphics(data);
+
+		// output must be bit-identical, also when written with pitch
+		// into larger image, which must be left intact around sprite
+		for (unsigned int i = 0; i < graphics.GetNumSprites(); i++) {
+			std::vector<unsigned char> reference = graphics.GetPixelsReference(i);
+			if (graphics.GetPixels(i) != reference)
+				failures++;
+
+			size_t row_size = graphics.GetWidth(i) * 4, pitch = row_size + 12;
+			std::vector<unsigned char> image(pitch * graphics.GetHeight(i), 0xaa);
+			graphics.GetPixels(i, image.data(), pitch);
+			for (size_t y = 0; y < graphics.GetHeight(i); y++)
+				if (!std::equal(reference.begin() + y * row_size, reference.begin() + (y + 1) * row_size, image.begin() + y * pitch) ||
+						std::count(image.begin() + y * pitch + row_size, image.begin() + (y + 1) * pitch, 0xaa) != 12)
+					failures++;
+		}
+
+		size_t checksum = 0;
+		double reference = Measure([&]() {
+			for (unsigned int i = 0; i < graphics.GetNumSprites(); i++)
+				checksum += graphics.GetPixelsReference(i)[i];
+		}, iterations);
+		double current = Measure([&]() {
+			for (unsigned int i = 0; i < graphics.GetNumSprites(); i++)
+				checksum += graphics.GetPixels(i)[i];
+		}, iterations);
+
+		double mpixels = 64.0 * 61 * 45 * iterations / 1000000.0;
+
+		std::cout << (transparent ? "transparent" : "opaque") << ": "
+		          << "reference " << mpixels / reference * 1000.0 << " Mpix/s, "
+		          << "current " << mpixels / current * 1000.0 << " Mpix/s, "
+		          << "speedup " << reference / current << "x"
+		          << " (" << checksum % 10 << ")" << std::endl;
+	}
+
+	if (failures > 0)
+		std::cerr << "Error: " << failures << " sprites differ from reference" << std::endl;
+
+	return failures > 0;
+}
+
+int main(int argc, char** argv) {
+	try {
+		return realmain(argc, argv);
+	} catch (std::exception& e) {
+		std::cerr << "Error: " << e.what() << std::endl;
+	}
+	return 1;
+}
@@ -54,6 +54,13 @@ uint32_t MemRange::GetDWord(size_t offset) const {
 #endif
 }
 
+uint64_t MemRange::GetQWord(size_t offset) const {
+	if (offset + 8 > GetSize())
+		throw std::out_of_range("GetQWord out of range");
+	// low dword first on all hosts
+	return ((uint64_t)GetDWord(offset + 4) << 32) | (uint64_t)GetDWord(offset);
+}
+
 int8_t MemRange::GetSByte(size_t offset) const {
 	return static_cast<int8_t>(GetByte(offset));
 }
@@ -72,6 +79,16 @@ std::string MemRange::GetString(size_t offset, size_t length) const {
 	return std::string(reinterpret_cast<const char*>(GetData() + offset), length);
 }
 
+uint64_t MemRange::GetChecksum() const {
+	// 64 bit FNV-1a
+	uint64_t hash = 14695981039346656037ULL;
+	for (const unsigned char* i = GetData(); i != GetData() + GetSize(); i++) {
+		hash ^= *i;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
 Slice MemRange::GetSlice(size_t offset) const {
 	return Slice(*this, offset);
 }
@@ -100,10 +117,22 @@ void Buffer::Append(unsigned char c) {
 	data_.push_back(c);
 }
 
+void Buffer::Append(unsigned char c, size_t count) {
+	data_.insert(data_.end(), count, c);
+}
+
+void Buffer::Append(const unsigned char* data, size_t size) {
+	data_.insert(data_.end(), data, data + size);
+}
+
 void Buffer::Reserve(size_t size) {
 	data_.reserve(size);
 }
 
+void Buffer::Clear() {
+	data_.clear();
+}
+
 // Slice
 Slice::Slice() : start_(nullptr), size_(0) {
 }
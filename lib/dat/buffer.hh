@@ -29,10 +29,9 @@
 class Slice;
 
 class MemRange {
-protected:
+public:
 	virtual ~MemRange() {}
 
-public:
 	virtual const unsigned char* GetData() const = 0;
 	virtual size_t GetSize() const = 0;
 
@@ -41,12 +40,15 @@ public:
 	uint8_t GetByte(size_t offset) const;
 	uint16_t GetWord(size_t offset) const;
 	uint32_t GetDWord(size_t offset) const;
+	uint64_t GetQWord(size_t offset) const;
 	int8_t GetSByte(size_t offset) const;
 	int16_t GetSWord(size_t offset) const;
 	int32_t GetSDWord(size_t offset) const;
 
 	std::string GetString(size_t offset, size_t length) const;
 
+	uint64_t GetChecksum() const;
+
 	Slice GetSlice(size_t offset) const;
 	Slice GetSlice(size_t offset, size_t length) const;
 };
@@ -72,7 +74,10 @@ public:
 	virtual size_t GetSize() const;
 
 	void Append(unsigned char c);
+	void Append(unsigned char c, size_t count);
+	void Append(const unsigned char* data, size_t size);
 	void Reserve(size_t size);
+	void Clear();
 };
 
 class Slice : public MemRange {
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATAREADER_HH
+#define DATAREADER_HH
+
+#include <array>
+#include <bit>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include <dat/buffer.hh>
+
+// Non-virtual view of memory range for reading little-endian fields
+//
+// Unlike MemRange accessors, fields are not range checked one by one:
+// instead, range of a whole record is checked once with GetRecord(),
+// and fields inside the record are read unchecked (only asserted)
+class DataReader {
+protected:
+	const unsigned char* data_;
+	size_t size_;
+
+public:
+	DataReader() : data_(nullptr), size_(0) {
+	}
+
+	DataReader(const unsigned char* data, size_t size) : data_(data), size_(size) {
+	}
+
+	DataReader(const MemRange& range) : data_(range.GetData()), size_(range.GetSize()) {
+	}
+
+	const unsigned char* GetData() const {
+		return data_;
+	}
+
+	size_t GetSize() const {
+		return size_;
+	}
+
+	bool HasRecord(size_t offset, size_t length) const {
+		return offset <= size_ && length <= size_ - offset;
+	}
+
+	// throws std::out_of_range if record does not fit
+	DataReader GetRecord(size_t offset, size_t length) const {
+		if (!HasRecord(offset, length))
+			throw std::out_of_range("record out of range");
+		return DataReader(data_ + offset, length);
+	}
+
+	// till the end of range
+	DataReader GetRecord(size_t offset) const {
+		if (offset > size_)
+			throw std::out_of_range("record out of range");
+		return DataReader(data_ + offset, size_ - offset);
+	}
+
+	template<class T>
+	T Get(size_t offset) const {
+		static_assert(std::is_integral<T>::value, "only integral fields are supported");
+		assert(offset + sizeof(T) <= size_);
+
+		std::array<unsigned char, sizeof(T)> bytes;
+		std::memcpy(bytes.data(), data_ + offset, sizeof(T));
+
+		T value = std::bit_cast<T>(bytes);
+		if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1)
+			value = std::byteswap(value);
+		return value;
+	}
+
+	uint8_t GetByte(size_t offset) const { return Get<uint8_t>(offset); }
+	uint16_t GetWord(size_t offset) const { return Get<uint16_t>(offset); }
+	uint32_t GetDWord(size_t offset) const { return Get<uint32_t>(offset); }
+	uint64_t GetQWord(size_t offset) const { return Get<uint64_t>(offset); }
+	int8_t GetSByte(size_t offset) const { return Get<int8_t>(offset); }
+	int16_t GetSWord(size_t offset) const { return Get<int16_t>(offset); }
+	int32_t GetSDWord(size_t offset) const { return Get<int32_t>(offset); }
+
+	bool HasString(size_t offset, const std::string& str) const {
+		assert(offset + str.size() <= size_);
+		return std::memcmp(data_ + offset, str.data(), str.size()) == 0;
+	}
+
+	std::string GetString(size_t offset, size_t length) const {
+		assert(offset + length <= size_);
+		return std::string(reinterpret_cast<const char*>(data_ + offset), length);
+	}
+};
+
+#endif // DATAREADER_HH
@@ -17,29 +17,54 @@
  * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <stdexcept>
 
 #include <dat/unpacker.hh>
+#include <dat/mappedfile.hh>
+#include <dat/datareader.hh>
 
 #include <dat/datfile.hh>
 
-DatFile::DatFile(const std::string& path) : file_(path, std::ios_base::in | std::ios_base::binary) {
+const size_t DatFile::stream_chunk_size_ = 64 * 1024;
+
+DatFile::DatFile(const std::string& path, Backend backend) : cache_stats_() {
+	if (backend == MMAP) {
+		mapping_.reset(new MappedFile(path));
+
+		// header and toc are read straight from the mapping
+		int num_entries = DataReader(*mapping_).GetRecord(0, datfile_header_size_).GetDWord(datfile_header_toc_legth_offset_);
+
+		ParseToc(mapping_->GetSlice(datfile_header_size_, datfile_toc_entry_size_ * num_entries), num_entries, mapping_->GetSize());
+		return;
+	}
+
 	// open file & determine size
 	file_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
+	file_.open(path, std::ios_base::in | std::ios_base::binary);
 	file_.seekg(0, std::ifstream::end);
 	size_t file_size = file_.tellg();
 	file_.seekg(0);
 
 	// read header
 	Buffer header(file_, datfile_header_size_);
-	int num_entries = header.GetDWord(datfile_header_toc_legth_offset_);
+	int num_entries = DataReader(header).GetRecord(0, datfile_header_size_).GetDWord(datfile_header_toc_legth_offset_);
 
 	// read table of contents
 	Buffer toc(file_, datfile_toc_entry_size_ * num_entries);
 
+	ParseToc(toc, num_entries, file_size);
+}
+
+DatFile::~DatFile() {
+}
+
+void DatFile::ParseToc(const MemRange& toc, int num_entries, size_t file_size) {
+	DataReader entries = DataReader(toc).GetRecord(0, (size_t)num_entries * datfile_toc_entry_size_);
+
 	for (int i = 0; i < num_entries; i++) {
-		Slice this_entry = toc.GetSlice(i * datfile_toc_entry_size_, datfile_toc_entry_size_);
+		DataReader this_entry(entries.GetData() + i * datfile_toc_entry_size_, datfile_toc_entry_size_);
 
 		// clear zero filling from name
 		std::string name = this_entry.GetString(datfile_toc_entry_name_offset_, datfile_toc_entry_name_size_);
@@ -48,9 +73,10 @@ DatFile::DatFile(const std::string& path) : file_(path, std::ios_base::in | std:
 
 		// calculate start end end of data for this entry
 		TocEntry entry_info;
+		entry_info.num = i;
 		entry_info.datfile_offset = this_entry.GetDWord(datfile_toc_entry_data_offset_offset_);
 		if (i < num_entries - 1) {
-			Slice next_entry = toc.GetSlice((i + 1) * datfile_toc_entry_size_, datfile_toc_entry_size_);
+			DataReader next_entry(entries.GetData() + (i + 1) * datfile_toc_entry_size_, datfile_toc_entry_size_);
 			entry_info.packed_size = next_entry.GetDWord(datfile_toc_entry_data_offset_offset_) - entry_info.datfile_offset;
 		} else {
 			entry_info.packed_size = file_size - entry_info.datfile_offset;
@@ -76,14 +102,68 @@ const DatFile::TocEntry& DatFile::GetTocEntry(const std::string& name) const {
 	return entry->second;
 }
 
-Buffer DatFile::GetData(const DatFile::TocEntry& entry) const {
-	file_.seekg(entry.datfile_offset);
-	Buffer packed(file_, entry.packed_size);
+std::shared_ptr<const Buffer> DatFile::GetData(const DatFile::TocEntry& entry) const {
+	std::unique_lock<std::mutex> lock(cache_mutex_);
+
+	if (cache_stats_.limit == 0) {
+		lock.unlock();
+		return std::make_shared<const Buffer>(Unpack(entry));
+	}
+
+	CacheMap::iterator cached = cache_entries_.find(entry.num);
+	if (cached != cache_entries_.end()) {
+		cache_stats_.hits++;
+		cache_lru_.splice(cache_lru_.begin(), cache_lru_, cached->second);
+		return cached->second->second;
+	}
+
+	cache_stats_.misses++;
+
+	// don't hold the lock while unpacking; if other thread
+	// unpacks the same entry meanwhile, the first one to
+	// finish gets cached
+	lock.unlock();
+	std::shared_ptr<const Buffer> unpacked = std::make_shared<const Buffer>(Unpack(entry));
+	lock.lock();
+
+	if (unpacked->GetSize() > cache_stats_.limit || cache_entries_.find(entry.num) != cache_entries_.end())
+		return unpacked;
+
+	EvictFromCache(cache_stats_.limit - unpacked->GetSize());
+
+	cache_lru_.emplace_front(entry.num, unpacked);
+	cache_entries_.emplace(entry.num, cache_lru_.begin());
+	cache_stats_.num_entries++;
+	cache_stats_.size += unpacked->GetSize();
+
+	return unpacked;
+}
+
+void DatFile::EvictFromCache(size_t limit) const {
+	while (cache_stats_.size > limit) {
+		cache_stats_.size -= cache_lru_.back().second->GetSize();
+		cache_stats_.num_entries--;
+		cache_stats_.evictions++;
 
+		cache_entries_.erase(cache_lru_.back().first);
+		cache_lru_.pop_back();
+	}
+}
+
+Buffer DatFile::Unpack(const DatFile::TocEntry& entry) const {
 	Buffer unpacked;
 	unpacked.Reserve(entry.unpacked_size_hint);
 
-	Unpacker().Process(packed, unpacked);
+	if (mapping_) {
+		Unpacker().Process(GetPackedData(entry), unpacked);
+	} else {
+		std::unique_lock<std::mutex> lock(file_mutex_);
+		file_.seekg(entry.datfile_offset);
+		Buffer packed(file_, entry.packed_size);
+		lock.unlock();
+
+		Unpacker().Process(packed, unpacked);
+	}
 
 	if (unpacked.GetSize() > entry.unpacked_size_hint)
 		throw std::logic_error("data is larger than expected unpacked size");
@@ -91,6 +171,59 @@ Buffer DatFile::GetData(const DatFile::TocEntry& entry) const {
 	return unpacked;
 }
 
+void DatFile::StreamData(const DatFile::TocEntry& entry, const ChunkProcessor& fn) const {
+	Unpacker unpacker;
+
+	Slice mapped;
+	if (mapping_)
+		mapped = GetPackedData(entry);
+
+	std::vector<unsigned char> packed(mapping_ ? 0 : stream_chunk_size_);
+	std::vector<unsigned char> unpacked(stream_chunk_size_);
+	size_t unpacked_size = 0;
+
+	size_t offset = 0;
+	while (offset < entry.packed_size && !unpacker.IsFinished()) {
+		size_t chunk_size = std::min(stream_chunk_size_, entry.packed_size - offset);
+		const unsigned char* chunk;
+
+		if (mapping_) {
+			chunk = mapped.GetData() + offset;
+		} else {
+			std::unique_lock<std::mutex> lock(file_mutex_);
+			file_.seekg(entry.datfile_offset + offset);
+			file_.read(reinterpret_cast<char*>(packed.data()), chunk_size);
+			chunk = packed.data();
+		}
+
+		offset += chunk_size;
+
+		size_t consumed = 0;
+		while (consumed < chunk_size && !unpacker.IsFinished()) {
+			consumed += unpacker.Push(chunk + consumed, chunk_size - consumed);
+
+			size_t size;
+			while ((size = unpacker.Pull(unpacked.data(), unpacked.size())) > 0) {
+				unpacked_size += size;
+				if (unpacked_size > entry.unpacked_size_hint)
+					throw std::logic_error("data is larger than expected unpacked size");
+
+				fn(unpacked.data(), size);
+			}
+		}
+	}
+
+	if (!unpacker.IsFinished())
+		throw std::logic_error("unexpected end of data");
+}
+
+Slice DatFile::GetPackedData(const DatFile::TocEntry& entry) const {
+	if (!mapping_)
+		throw std::logic_error("packed data access requires mmap backend");
+
+	return mapping_->GetSlice(entry.datfile_offset, entry.packed_size);
+}
+
 int DatFile::GetCount() const {
 	return toc_by_num_.size();
 }
@@ -99,14 +232,68 @@ std::string DatFile::GetName(int num) const {
 	return toc_by_num_.at(num).name;
 }
 
+size_t DatFile::GetPackedSize(int num) const {
+	return toc_by_num_.at(num).packed_size;
+}
+
+size_t DatFile::GetUnpackedSizeHint(int num) const {
+	return toc_by_num_.at(num).unpacked_size_hint;
+}
+
 bool DatFile::Exists(const std::string& name) const {
 	return toc_by_name_.find(name) != toc_by_name_.end();
 }
 
-Buffer DatFile::GetData(int num) const {
+std::shared_ptr<const Buffer> DatFile::GetData(int num) const {
 	return GetData(GetTocEntry(num));
 }
 
-Buffer DatFile::GetData(const std::string& name) const {
+std::shared_ptr<const Buffer> DatFile::GetData(const std::string& name) const {
 	return GetData(GetTocEntry(name));
 }
+
+void DatFile::StreamData(int num, const ChunkProcessor& fn) const {
+	StreamData(GetTocEntry(num), fn);
+}
+
+void DatFile::StreamData(const std::string& name, const ChunkProcessor& fn) const {
+	StreamData(GetTocEntry(name), fn);
+}
+
+Slice DatFile::GetPackedData(int num) const {
+	return GetPackedData(GetTocEntry(num));
+}
+
+Slice DatFile::GetPackedData(const std::string& name) const {
+	return GetPackedData(GetTocEntry(name));
+}
+
+uint64_t DatFile::GetChecksum() const {
+	std::call_once(checksum_calculated_, &DatFile::CalculateChecksum, this);
+	return checksum_;
+}
+
+void DatFile::CalculateChecksum() const {
+	if (mapping_) {
+		checksum_ = mapping_->GetChecksum();
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(file_mutex_);
+	file_.seekg(0, std::ifstream::end);
+	size_t file_size = file_.tellg();
+	file_.seekg(0);
+
+	checksum_ = Buffer(file_, file_size).GetChecksum();
+}
+
+void DatFile::SetCacheLimit(size_t limit) {
+	std::lock_guard<std::mutex> lock(cache_mutex_);
+	EvictFromCache(limit);
+	cache_stats_.limit = limit;
+}
+
+DatFile::CacheStats DatFile::GetCacheStats() const {
+	std::lock_guard<std::mutex> lock(cache_mutex_);
+	return cache_stats_;
+}
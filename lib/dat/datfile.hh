@@ -21,13 +21,39 @@
 #define DATFILE_HH
 
 #include <map>
+#include <list>
+#include <vector>
 #include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 #include "buffer.hh"
 
+class MappedFile;
+
 class DatFile {
+public:
+	enum Backend {
+		STREAM, // read packed entries through std::ifstream
+		MMAP,   // map the whole file and unpack entries in place
+	};
+
+	struct CacheStats {
+		unsigned long hits;
+		unsigned long misses;
+		unsigned long evictions;
+
+		size_t num_entries;
+		size_t size;
+		size_t limit;
+	};
+
+	typedef std::function<void(const unsigned char* data, size_t size)> ChunkProcessor;
+
 protected:
 	struct TocEntry {
+		int num;
 		std::string name;
 		off_t datfile_offset;
 		size_t packed_size;
@@ -36,11 +62,27 @@ protected:
 	typedef std::vector<TocEntry> TocVector;
 	typedef std::map<std::string, TocEntry> TocMap;
 
+	// most recently used entries are at the front
+	typedef std::list<std::pair<int, std::shared_ptr<const Buffer>>> CacheList;
+	typedef std::map<int, CacheList::iterator> CacheMap;
+
 protected:
 	mutable std::ifstream file_;
+	mutable std::mutex file_mutex_; // serializes seek+read on file_
+	std::unique_ptr<MappedFile> mapping_;
 	TocVector toc_by_num_;
 	TocMap toc_by_name_;
 
+	mutable std::mutex cache_mutex_;
+	mutable CacheList cache_lru_;
+	mutable CacheMap cache_entries_;
+	mutable CacheStats cache_stats_;
+
+	// file contents don't change while opened, so checksum is
+	// only calculated on first request
+	mutable std::once_flag checksum_calculated_;
+	mutable uint64_t checksum_ = 0;
+
 protected:
 	static const int datfile_header_size_ = 16;
 	static const int datfile_header_toc_legth_offset_ = 0;
@@ -54,22 +96,57 @@ protected:
 
 	static const int datfile_paragraph_size_ = 16;
 
+	static const size_t stream_chunk_size_;
+
 protected:
+	void ParseToc(const MemRange& toc, int num_entries, size_t file_size);
+	void CalculateChecksum() const;
+
 	const TocEntry& GetTocEntry(int num) const;
 	const TocEntry& GetTocEntry(const std::string& name) const;
 
-	Buffer GetData(const TocEntry& entry) const;
+	std::shared_ptr<const Buffer> GetData(const TocEntry& entry) const;
+	Buffer Unpack(const TocEntry& entry) const;
+	void EvictFromCache(size_t limit) const;
+	Slice GetPackedData(const TocEntry& entry) const;
+	void StreamData(const TocEntry& entry, const ChunkProcessor& fn) const;
 
 public:
-	DatFile(const std::string& path);
+	// GetData() may be called concurrently from multiple threads
+	DatFile(const std::string& path, Backend backend = STREAM);
+	~DatFile();
 
 	int GetCount() const;
 	std::string GetName(int num) const;
 
+	// these come from table of contents, without unpacking; unpacked
+	// size is an upper bound, in multiples of paragraph size
+	size_t GetPackedSize(int num) const;
+	size_t GetUnpackedSizeHint(int num) const;
+
 	bool Exists(const std::string& name) const;
 
-	Buffer GetData(int num) const;
-	Buffer GetData(const std::string& name) const;
+	// unpacked data is shared with the cache, so it's not copied
+	// when requested again
+	std::shared_ptr<const Buffer> GetData(int num) const;
+	std::shared_ptr<const Buffer> GetData(const std::string& name) const;
+
+	// unpacks entry in constant memory, passing unpacked data to
+	// given function in chunks; does not use the cache
+	void StreamData(int num, const ChunkProcessor& fn) const;
+	void StreamData(const std::string& name, const ChunkProcessor& fn) const;
+
+	// only available with MMAP backend; slice is valid while DatFile lives
+	Slice GetPackedData(int num) const;
+	Slice GetPackedData(const std::string& name) const;
+
+	// checksum of the whole .DAT file contents; memoised
+	uint64_t GetChecksum() const;
+
+	// keep up to limit bytes of most recently unpacked entries in
+	// memory; cache is disabled (limit is 0) by default
+	void SetCacheLimit(size_t limit);
+	CacheStats GetCacheStats() const;
 };
 
 #endif // DATFILE_HH
@@ -18,179 +18,308 @@
  */
 
 #include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#if defined __GNUC__ && (defined __x86_64__ || defined __i386__)
+#	include <immintrin.h>
+#	define DATGRAPHICS_AVX2
+#endif
 
 #include <dat/buffer.hh>
+#include <dat/datareader.hh>
 
 #include <dat/datgraphics.hh>
 
-DatGraphics::DatGraphics(const MemRange& data) : data_(data) {
-	// Get section ranges (GRAPHICS, SPRITES and PALETTE)
-	Slice graphics_section = data.GetSlice(0, FileStruct::Graphics::size);
+typedef void (*ExpandOpaqueFunction)(const uint32_t* lut, const unsigned char* in, unsigned char* out, size_t count);
+
+static void ExpandOpaqueScalar(const uint32_t* lut, const unsigned char* in, unsigned char* out, size_t count) {
+	for (size_t i = 0; i < count; i++)
+		std::memcpy(out + i * 4, &lut[in[i]], 4);
+}
+
+#if defined DATGRAPHICS_AVX2
+__attribute__((target("avx2")))
+static void ExpandOpaqueAVX2(const uint32_t* lut, const unsigned char* in, unsigned char* out, size_t count) {
+	size_t i = 0;
 
-	if (graphics_section.GetString(0, 8) != "GRAPHICS")
-		throw std::logic_error("bad graphics file (expected GRAPHICS section)");
+	// 8 indexes are zero extended to dwords and used to gather pixels from lut
+	for (; i + 8 <= count; i += 8) {
+		__m256i indexes = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+		__m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), indexes, 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), pixels);
+	}
+
+	ExpandOpaqueScalar(lut, in + i, out + i * 4, count - i);
+}
+#endif
+
+static ExpandOpaqueFunction ChooseExpandOpaque() {
+#if defined DATGRAPHICS_AVX2
+	if (__builtin_cpu_supports("avx2"))
+		return ExpandOpaqueAVX2;
+#endif
+	return ExpandOpaqueScalar;
+}
 
-	transparency_ = graphics_section.GetByte(FileStruct::Graphics::offs_transparency_flag);
+const char* DatGraphics::CheckHeaders(const MemRange& data) {
+	DataReader file(data);
+
+	if (!file.HasRecord(0, FileStruct::Graphics::size) || !file.HasString(0, "GRAPHICS"))
+		return "bad graphics file (expected GRAPHICS section)";
+
+	size_t sprites_length = file.GetDWord(FileStruct::Graphics::offs_sprites_length);
+	if (!file.HasRecord(FileStruct::Graphics::size, sprites_length))
+		return "bad graphics file (SPRITES section out of range)";
+
+	DataReader sprites = file.GetRecord(FileStruct::Graphics::size, sprites_length);
+	if (sprites.HasRecord(0, FileStruct::Sprites::Header::size) && sprites.HasString(0, "SPRITES ")) {
+		if (sprites.GetDWord(FileStruct::Sprites::Header::offs_blocks_unk0) != 0)
+			return "probably BLOCKS file, not supported yet";
+
+		size_t num_sprites = sprites.GetWord(FileStruct::Sprites::Header::offs_num_sprites);
+		if (!sprites.HasRecord(FileStruct::Sprites::Header::size, num_sprites * FileStruct::Sprites::Entry::size))
+			return "bad graphics file (sprite table out of range)";
+	} else if (sprites.HasRecord(0, FileStruct::Picture::Header::size) && sprites.HasString(0, "PICTURE ")) {
+		size_t width = sprites.GetWord(FileStruct::Picture::Header::offs_width);
+		size_t height = sprites.GetWord(FileStruct::Picture::Header::offs_height);
+		if (!sprites.HasRecord(FileStruct::Picture::Header::size, width * height))
+			return "bad graphics file (picture data out of range)";
+	} else {
+		return "unknown graphics file";
+	}
 
-	size_t sprites_length = graphics_section.GetDWord(FileStruct::Graphics::offs_sprites_length);
+	DataReader palette = file.GetRecord(FileStruct::Graphics::size + sprites_length);
+	if (!palette.HasRecord(0, FileStruct::Palette::Header::size) || !palette.HasString(0, "PALETTE "))
+		return "bad graphics file (expected PALETTE section)";
 
-	Slice sprites_section = data.GetSlice(FileStruct::Graphics::size, sprites_length);
-	Slice palette_section = data.GetSlice(FileStruct::Graphics::size + sprites_length);
+	size_t num_colors = palette.GetWord(FileStruct::Palette::Header::offs_num_colors);
+	if (!palette.HasRecord(FileStruct::Palette::Header::size, num_colors * 3))
+		return "bad graphics file (palette out of range)";
 
-	// Parse SPRITES
-	if (sprites_section.GetString(0, 8) == "SPRITES ") {
-		if (sprites_section.GetDWord(FileStruct::Sprites::Header::offs_blocks_unk0) != 0)
-			throw std::logic_error("probably BLOCKS file, not supported yet");
+	return nullptr;
+}
 
-		int num_sprites = sprites_section.GetWord(FileStruct::Sprites::Header::offs_num_sprites);
+bool DatGraphics::IsGraphics(const MemRange& data) {
+	return CheckHeaders(data) == nullptr;
+}
 
-		for (int i = 0; i < num_sprites; i++) {
-			Slice sprite_entry(sprites_section.GetSlice(FileStruct::Sprites::Header::size + i * FileStruct::Sprites::Entry::size, FileStruct::Sprites::Entry::size));
+DatGraphics::DatGraphics(const MemRange& data) : data_(data) {
+	if (const char* error = CheckHeaders(data))
+		throw std::logic_error(error);
 
-			Sprite sprite;
+	// all ranges used below were checked
+	DataReader file(data);
 
-			sprite.framewidth = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_frame_width);
-			sprite.frameheight = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_frame_height);
-			sprite.xoffset = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_x_offset);
-			sprite.yoffset = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_y_offset);
-			sprite.width = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_width);
-			sprite.height = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_height);
+	transparency_ = file.GetByte(FileStruct::Graphics::offs_transparency_flag);
 
-			size_t this_data_offset = sprite_entry.GetDWord(FileStruct::Sprites::Entry::offs_data_offset);
+	size_t sprites_length = file.GetDWord(FileStruct::Graphics::offs_sprites_length);
 
-			if (i < num_sprites - 1) {
-				Slice next_sprite_entry(sprites_section.GetSlice(FileStruct::Sprites::Header::size + (i + 1) * FileStruct::Sprites::Entry::size, FileStruct::Sprites::Entry::size));
-				size_t next_data_offset = next_sprite_entry.GetDWord(FileStruct::Sprites::Entry::offs_data_offset);
-				sprite.data = sprites_section.GetSlice(this_data_offset, next_data_offset - this_data_offset);
-			} else {
-				sprite.data = sprites_section.GetSlice(this_data_offset); // till the end of sprites section
-			}
+	sprites_section_ = data.GetSlice(FileStruct::Graphics::size, sprites_length);
+	DataReader sprites(sprites_section_);
 
-			sprites_.push_back(sprite);
-		}
-	} else if (sprites_section.GetString(0, 8) == "PICTURE ") {
-		Sprite sprite;
+	picture_ = sprites.HasString(0, "PICTURE ");
+	if (picture_) {
+		num_sprites_ = 1;
+	} else {
+		num_sprites_ = sprites.GetWord(FileStruct::Sprites::Header::offs_num_sprites);
+		sprite_entries_ = sprites.GetRecord(FileStruct::Sprites::Header::size, num_sprites_ * FileStruct::Sprites::Entry::size);
+	}
 
-		sprite.framewidth = sprite.width = sprites_section.GetWord(FileStruct::Picture::Header::offs_width);
-		sprite.frameheight = sprite.height = sprites_section.GetWord(FileStruct::Picture::Header::offs_height);
+	DataReader palette = file.GetRecord(FileStruct::Graphics::size + sprites_length);
+
+	num_colors_ = palette.GetWord(FileStruct::Palette::Header::offs_num_colors);
+	palette_colors_ = palette.GetRecord(FileStruct::Palette::Header::size, num_colors_ * 3);
+}
+
+DatGraphics::Sprite DatGraphics::GetSprite(unsigned int num) const {
+	if (num >= num_sprites_)
+		throw std::out_of_range("frame number out of range");
+
+	Sprite sprite;
+
+	if (picture_) {
+		DataReader header(sprites_section_);
+
+		sprite.framewidth = sprite.width = header.GetWord(FileStruct::Picture::Header::offs_width);
+		sprite.frameheight = sprite.height = header.GetWord(FileStruct::Picture::Header::offs_height);
 		sprite.xoffset = sprite.yoffset = 0;
-		sprite.data = sprites_section.GetSlice(FileStruct::Picture::Header::size, sprite.width * sprite.height);
+		sprite.data = sprites_section_.GetSlice(FileStruct::Picture::Header::size, sprite.width * sprite.height);
+
+		return sprite;
+	}
 
-		sprites_.push_back(sprite);
+	DataReader sprite_entry(sprite_entries_.GetData() + num * FileStruct::Sprites::Entry::size, FileStruct::Sprites::Entry::size);
+
+	sprite.framewidth = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_frame_width);
+	sprite.frameheight = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_frame_height);
+	sprite.xoffset = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_x_offset);
+	sprite.yoffset = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_y_offset);
+	sprite.width = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_width);
+	sprite.height = sprite_entry.GetWord(FileStruct::Sprites::Entry::offs_height);
+
+	size_t this_data_offset = sprite_entry.GetDWord(FileStruct::Sprites::Entry::offs_data_offset);
+
+	if (num < num_sprites_ - 1) {
+		DataReader next_sprite_entry(sprite_entry.GetData() + FileStruct::Sprites::Entry::size, FileStruct::Sprites::Entry::size);
+		size_t next_data_offset = next_sprite_entry.GetDWord(FileStruct::Sprites::Entry::offs_data_offset);
+		sprite.data = sprites_section_.GetSlice(this_data_offset, next_data_offset - this_data_offset);
 	} else {
-		throw std::logic_error("unknown graphics file");
+		sprite.data = sprites_section_.GetSlice(this_data_offset); // till the end of sprites section
 	}
 
-	// Parse PALETTE
-	if (palette_section.GetString(0, 8) != "PALETTE ")
-		throw std::logic_error("bad graphics file (expected PALETTE section)");
+	return sprite;
+}
 
-	int num_colors = palette_section.GetWord(FileStruct::Palette::Header::offs_num_colors);
+const std::vector<DatGraphics::Color>& DatGraphics::GetPalette() const {
+	std::call_once(palette_decoded_, &DatGraphics::DecodePalette, this);
+	return palette_;
+}
 
-	for (int i = 0; i < num_colors; i++) {
+void DatGraphics::DecodePalette() const {
+	palette_.reserve(num_colors_);
+	for (unsigned int i = 0; i < num_colors_; i++) {
 		Color c;
-		c.red = FixColor(palette_section.GetByte(FileStruct::Palette::Header::size + i * 3));
-		c.green = FixColor(palette_section.GetByte(FileStruct::Palette::Header::size + i * 3 + 1));
-		c.blue = FixColor(palette_section.GetByte(FileStruct::Palette::Header::size + i * 3 + 2));
+		c.red = FixColor(palette_colors_.GetByte(i * 3));
+		c.green = FixColor(palette_colors_.GetByte(i * 3 + 1));
+		c.blue = FixColor(palette_colors_.GetByte(i * 3 + 2));
 
 		palette_.push_back(c);
 	}
+
+	for (int i = 0; i < 256; i++) {
+		unsigned char pixel[4] = { 0, 0, 0, 0 };
+
+		if (i < (int)palette_.size()) {
+			pixel[0] = palette_[i].blue;
+			pixel[1] = palette_[i].green;
+			pixel[2] = palette_[i].red;
+			pixel[3] = 255;
+		}
+
+		std::memcpy(&palette_lut_[i], pixel, 4);
+	}
 }
 
 unsigned int DatGraphics::GetNumSprites() const {
-	return sprites_.size();
+	return num_sprites_;
 }
 
 unsigned short DatGraphics::GetWidth(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
-	return sprites_[num].width;
+	return GetSprite(num).width;
 }
 
 unsigned short DatGraphics::GetHeight(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
-	return sprites_[num].height;
+	return GetSprite(num).height;
 }
 
 unsigned short DatGraphics::GetFrameWidth(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
-	return sprites_[num].framewidth;
+	return GetSprite(num).framewidth;
 }
 
 unsigned short DatGraphics::GetFrameHeight(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
-	return sprites_[num].frameheight;
+	return GetSprite(num).frameheight;
 }
 
 unsigned short DatGraphics::GetXOffset(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
-	return sprites_[num].xoffset;
+	return GetSprite(num).xoffset;
 }
 
 unsigned short DatGraphics::GetYOffset(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
-	return sprites_[num].yoffset;
+	return GetSprite(num).yoffset;
 }
 
-std::vector<unsigned char> DatGraphics::GetPixels(unsigned int num) const {
-	if (num >= sprites_.size())
-		throw std::out_of_range("frame number out of range");
+void DatGraphics::ExpandTransparent(const Slice& data, size_t width, size_t height, unsigned char* pixels, size_t pitch) const {
+	const unsigned char* in = data.GetData();
+	size_t in_size = data.GetSize();
 
-	size_t pixels_size = sprites_[num].width * sprites_[num].height * 4;
+	size_t data_pos = 0;
+	size_t row = 0;
+	size_t pixel_in_line = 0;
+	size_t num_colors = num_colors_;
+	bool bad_color = false;
 
-	std::vector<unsigned char> pixels(pixels_size, 0);
+	static const uint32_t transparent_pixel = 0;
 
-	const Slice& data = sprites_[num].data;
+	if (width == 0)
+		return;
 
-	size_t data_pos = 0;
-	size_t out_pos = 0;
-	size_t pixel_in_line = 0;
-	unsigned char mask;
-	size_t width = sprites_[num].width;
+	// each mask byte describes up to 8 pixels (less at the end of
+	// line), set bits correspond to opaque pixels which colors follow
+	while (data_pos < in_size && row < height) {
+		unsigned char mask = in[data_pos++];
+		unsigned char* out = pixels + row * pitch + pixel_in_line * 4;
 
-	if (transparency_) {
-		while (data_pos < data.GetSize() && out_pos + 4 <= pixels_size) {
-			mask = data[data_pos++];
+		size_t npixels = std::min<size_t>(8, width - pixel_in_line);
 
-			// optimize by computing max. available number of iterations
-			for (int j = 0; j < 8 && pixel_in_line < width && data_pos < data.GetSize() && out_pos + 4 <= pixels_size; j++, pixel_in_line++) {
+		if (data_pos + npixels <= in_size) {
+			// whole group fits, so no checks are needed, and it's
+			// also safe to read next byte for transparent pixels
+			// which allows to avoid branching
+			for (size_t j = 0; j < npixels; j++, out += 4) {
+				unsigned int opaque = (mask >> (7 - j)) & 1;
+				unsigned char color = in[data_pos];
+				uint32_t pixel = palette_lut_[color] & -opaque;
+
+				bad_color |= opaque & (color >= num_colors);
+				std::memcpy(out, &pixel, 4);
+
+				data_pos += opaque;
+			}
+			pixel_in_line += npixels;
+		} else {
+			// last group or truncated data
+			for (int j = 0; j < 8 && pixel_in_line < width; j++, pixel_in_line++, out += 4) {
 				if (mask & (0x80 >> j)) {
-					unsigned char color = data[data_pos++];
-					if (color >= palette_.size())
-						throw std::logic_error("color not found in the palette");
-
-					pixels[out_pos++] = palette_[color].blue;
-					pixels[out_pos++] = palette_[color].green;
-					pixels[out_pos++] = palette_[color].red;
-					pixels[out_pos++] = 255;
+					if (data_pos >= in_size)
+						break;
+					bad_color |= in[data_pos] >= num_colors;
+					std::memcpy(out, &palette_lut_[in[data_pos++]], 4);
 				} else {
-					pixels[out_pos++] = 0;
-					pixels[out_pos++] = 0;
-					pixels[out_pos++] = 0;
-					pixels[out_pos++] = 0;
+					std::memcpy(out, &transparent_pixel, 4);
 				}
 			}
-
-			if (pixel_in_line == width)
-				pixel_in_line = 0;
 		}
-	} else {
-		for (; data_pos < data.GetSize() && out_pos + 4 <= pixels_size; ) {
-			unsigned char color = data[data_pos++];
-			if (color >= palette_.size())
-				throw std::logic_error("color not found in the palette");
-
-			pixels[out_pos++] = palette_[color].blue;
-			pixels[out_pos++] = palette_[color].green;
-			pixels[out_pos++] = palette_[color].red;
-			pixels[out_pos++] = 255;
+
+		if (pixel_in_line == width) {
+			pixel_in_line = 0;
+			row++;
 		}
 	}
 
+	if (bad_color)
+		throw std::logic_error("color not found in the palette");
+}
+
+void DatGraphics::ExpandOpaque(const Slice& data, size_t width, size_t height, unsigned char* pixels, size_t pitch) const {
+	static const ExpandOpaqueFunction expand = ChooseExpandOpaque();
+
+	size_t count = std::min(data.GetSize(), width * height);
+
+	if (count > 0 && *std::max_element(data.GetData(), data.GetData() + count) >= num_colors_)
+		throw std::logic_error("color not found in the palette");
+
+	for (size_t row = 0; row * width < count; row++)
+		expand(palette_lut_, data.GetData() + row * width, pixels + row * pitch, std::min(width, count - row * width));
+}
+
+std::vector<unsigned char> DatGraphics::GetPixels(unsigned int num) const {
+	Sprite sprite = GetSprite(num);
+
+	std::vector<unsigned char> pixels(sprite.width * sprite.height * 4, 0);
+
+	GetPixels(num, pixels.data(), sprite.width * 4);
+
 	return pixels;
 }
+
+void DatGraphics::GetPixels(unsigned int num, unsigned char* pixels, size_t pitch) const {
+	Sprite sprite = GetSprite(num);
+
+	GetPalette();
+
+	if (transparency_)
+		ExpandTransparent(sprite.data, sprite.width, sprite.height, pixels, pitch);
+	else
+		ExpandOpaque(sprite.data, sprite.width, sprite.height, pixels, pitch);
+}
@@ -21,11 +21,16 @@
 #define DATGRAPHICS_HH
 
 #include <vector>
+#include <mutex>
+#include <cstdint>
 
 #include <dat/buffer.hh>
+#include <dat/datareader.hh>
 
+// Only section headers are validated on construction; sprite
+// headers and palette are decoded when they're first needed
 class DatGraphics {
-protected:
+public:
 	struct Sprite {
 		unsigned short width;
 		unsigned short height;
@@ -36,6 +41,7 @@ protected:
 		Slice data;
 	};
 
+protected:
 	struct Color {
 		unsigned char red;
 		unsigned char green;
@@ -45,9 +51,23 @@ protected:
 protected:
 	const MemRange& data_;
 
-	std::vector<Sprite> sprites_;
-	std::vector<Color> palette_;
 	bool transparency_;
+	bool picture_; // single PICTURE instead of SPRITES table
+
+	Slice sprites_section_;
+	DataReader sprite_entries_; // empty for PICTURE
+	unsigned int num_sprites_;
+
+	DataReader palette_colors_;
+	unsigned int num_colors_;
+
+	// decoded on first use, may be used concurrently
+	mutable std::once_flag palette_decoded_;
+	mutable std::vector<Color> palette_;
+
+	// palette expanded to BGRA pixels; indexes past the
+	// palette end map to transparent black
+	mutable uint32_t palette_lut_[256];
 
 protected:
 	struct FileStruct {
@@ -91,15 +111,31 @@ protected:
 	};
 
 protected:
-	inline unsigned char FixColor(unsigned char color) {
+	static inline unsigned char FixColor(unsigned char color) {
 		return (color << 2) | (color >> 4);
 	}
 
+	// returns nullptr if section headers are valid
+	static const char* CheckHeaders(const MemRange& data);
+
+	const std::vector<Color>& GetPalette() const;
+	void DecodePalette() const;
+
+	void ExpandTransparent(const Slice& data, size_t width, size_t height, unsigned char* pixels, size_t pitch) const;
+	void ExpandOpaque(const Slice& data, size_t width, size_t height, unsigned char* pixels, size_t pitch) const;
+
 public:
 	DatGraphics(const MemRange& data);
 
+	// cheap check whether data looks like graphics file
+	static bool IsGraphics(const MemRange& data);
+
 	unsigned int GetNumSprites() const;
 
+	// decodes whole sprite header at once; getters below
+	// decode it on each call
+	Sprite GetSprite(unsigned int num) const;
+
 	unsigned short GetWidth(unsigned int num) const;
 	unsigned short GetHeight(unsigned int num) const;
 	unsigned short GetFrameWidth(unsigned int num) const;
@@ -108,6 +144,11 @@ public:
 	unsigned short GetYOffset(unsigned int num) const;
 
 	std::vector<unsigned char> GetPixels(unsigned int num) const;
+
+	// writes BGRA pixels into width x height rectangle with given
+	// pitch; pixels not covered by (truncated) sprite data are
+	// left untouched, so destination should be cleared beforehand
+	void GetPixels(unsigned int num, unsigned char* pixels, size_t pitch) const;
 };
 
 #endif // DATGRAPHICS_HH
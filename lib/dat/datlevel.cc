@@ -19,7 +19,13 @@
 
 #include <set>
 #include <cassert>
+#include <cstring>
+#include <algorithm>
 #include <iostream>
+#include <stdexcept>
+#include <type_traits>
+
+#include <dat/datareader.hh>
 
 #include <dat/datlevel.hh>
 
@@ -53,35 +59,53 @@ const std::map<unsigned short, std::string> DatLevel::gfx_resources_ = {
 	{ 0xb06e, "BLDG6" },
 };
 
-DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int width_blocks, int height_blocks) {
+static_assert(std::is_trivially_copyable<DatLevel::BuildingInstance>::value, "level image arrays must be trivially copyable");
+static_assert(std::is_trivially_copyable<DatLevel::UnitInstance>::value, "level image arrays must be trivially copyable");
+static_assert(std::is_trivially_copyable<DatLevel::BuildingType::BBox>::value, "level image arrays must be trivially copyable");
+
+const char DatLevel::image_magic_[8] = { 'O', 'S', 'L', 'E', 'V', 'E', 'L', '1' };
+
+DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int width_blocks, int height_blocks, uint64_t source_checksum) {
+	std::vector<BuildingInstance> building_instances;
+	std::vector<UnitInstance> unit_instances;
+	std::set<unsigned short> building_type_ids;
+
+	// records are range checked as a whole, fields are read unchecked
+	DataReader level(leveldata);
+	DataReader things(thingsdata);
+
 	//
 	// First block table encodes buildings
 	//
 	int last_offset = 0;
 	int table_offset = last_offset;
+	DataReader building_table = level.GetRecord(table_offset, width_blocks * height_blocks * 2);
 	for (int nblock = 0; nblock < width_blocks * height_blocks; nblock++) {
-		int blockdata_offset = leveldata.GetWord(table_offset + nblock * 2);
-		int data_count = leveldata.GetWord(blockdata_offset);
+		int blockdata_offset = building_table.GetWord(nblock * 2);
 
 		if (blockdata_offset == 0)
 			continue;
 
+		int data_count = level.GetRecord(blockdata_offset, 2).GetWord(0);
+		DataReader data_offsets = level.GetRecord(blockdata_offset + 2, data_count * 2);
+
 		last_offset = blockdata_offset + 2 + data_count * 2;
 		for (int ndata = 0; ndata < data_count; ndata++) {
-			int data_offset = leveldata.GetWord(blockdata_offset + 2 + 2 * ndata);
+			int data_offset = data_offsets.GetWord(2 * ndata);
+			DataReader entry = level.GetRecord(data_offset, 18);
 
 			BuildingInstance obj;
-			obj.type = leveldata.GetWord(data_offset);
-			obj.sprite_y = leveldata.GetSWord(data_offset + 2) * 8;
-			obj.sprite_x = leveldata.GetSWord(data_offset + 4) * 8;
-			obj.y = leveldata.GetWord(data_offset + 6);
-			obj.x = leveldata.GetWord(data_offset + 8);
+			obj.type = entry.GetWord(0);
+			obj.sprite_y = entry.GetSWord(2) * 8;
+			obj.sprite_x = entry.GetSWord(4) * 8;
+			obj.y = entry.GetWord(6);
+			obj.x = entry.GetWord(8);
 
 			if (data_offset != last_offset) {
 				assert(data_offset == last_offset + 6);
-				obj.dead_type = leveldata.GetWord(last_offset);
-				obj.dead_sprite_y = leveldata.GetSWord(data_offset + 2) * 8;
-				obj.dead_sprite_x = leveldata.GetSWord(data_offset + 4) * 8;
+				obj.dead_type = level.GetRecord(last_offset, 2).GetWord(0);
+				obj.dead_sprite_y = entry.GetSWord(2) * 8;
+				obj.dead_sprite_x = entry.GetSWord(4) * 8;
 			}
 
 			// 18 bytes of mandatory data is followed
@@ -90,8 +114,9 @@ DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int wi
 			// (e.g. fuel pickup or enemy appears nearby)
 			int effect_offset = data_offset + 18;
 			while (1) {
-				//int effect_type = leveldata.GetByte(effect_offset);
-				int effect_data_len = leveldata.GetByte(effect_offset+1);
+				DataReader effect = level.GetRecord(effect_offset, 2);
+				//int effect_type = effect.GetByte(0);
+				int effect_data_len = effect.GetByte(1);
 
 				if (effect_data_len == 0)
 					break;
@@ -100,11 +125,11 @@ DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int wi
 			}
 			last_offset = effect_offset + 2;
 
-			building_instances_.emplace_back(obj);
+			building_instances.emplace_back(obj);
 
-			building_types_.emplace(std::make_pair(obj.type, BuildingType()));
+			building_type_ids.insert(obj.type);
 			if (obj.dead_type)
-				building_types_.emplace(std::make_pair(obj.dead_type, BuildingType()));
+				building_type_ids.insert(obj.dead_type);
 		}
 	}
 
@@ -112,21 +137,25 @@ DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int wi
 	// Second block table encodes units
 	//
 	table_offset = last_offset;
+	DataReader unit_table = level.GetRecord(table_offset, width_blocks * height_blocks * 2);
 	for (int nblock = 0; nblock < width_blocks * height_blocks; nblock++) {
-		int blockdata_offset = leveldata.GetWord(table_offset + nblock * 2);
-		int data_count = leveldata.GetWord(blockdata_offset);
+		int blockdata_offset = unit_table.GetWord(nblock * 2);
 
 		if (blockdata_offset == 0)
 			continue;
 
+		int data_count = level.GetRecord(blockdata_offset, 2).GetWord(0);
+		DataReader data_offsets = level.GetRecord(blockdata_offset + 2, data_count * 2);
+
 		last_offset = blockdata_offset + 2 + data_count * 2;
 		for (int ndata = 0; ndata < data_count; ndata++) {
-			int data_offset = leveldata.GetWord(blockdata_offset + 2 + 2 * ndata);
+			int data_offset = data_offsets.GetWord(2 * ndata);
+			DataReader entry = level.GetRecord(data_offset, 20);
 
 			UnitInstance obj;
-			obj.y = leveldata.GetWord(data_offset + 6);
-			obj.x = leveldata.GetWord(data_offset + 8);
-			obj.z = leveldata.GetSWord(data_offset + 10);
+			obj.y = entry.GetWord(6);
+			obj.x = entry.GetWord(8);
+			obj.z = entry.GetSWord(10);
 
 			// 20 bytes of mandatory data is followed
 			// by chunks which presumably encode what
@@ -134,7 +163,7 @@ DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int wi
 			// (e.g. objective is counted complete)
 			int effect_offset = data_offset + 20;
 			while (1) {
-				int effect_data_len = leveldata.GetByte(effect_offset+1);
+				int effect_data_len = level.GetRecord(effect_offset, 2).GetByte(1);
 
 				if (effect_data_len == 0)
 					break;
@@ -143,7 +172,7 @@ DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int wi
 			}
 			last_offset = effect_offset + 2;
 
-			unit_instances_.emplace_back(obj);
+			unit_instances.emplace_back(obj);
 
 			// TODO: create unit type
 		}
@@ -155,40 +184,174 @@ DatLevel::DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int wi
 	//
 	// Load extra data from other files (buildings)
 	//
-	for (auto& type : building_types_) {
-		unsigned short blocks_identifier = thingsdata.GetWord(type.first);
+	std::vector<BuildingTypeRecord> building_types;
+	std::vector<unsigned short> blocks;
+	std::vector<BuildingType::BBox> bboxes;
+	for (auto& id : building_type_ids) {
+		BuildingTypeRecord type = {};
+		type.id = id;
 
-		type.second.width = thingsdata.GetWord(type.first + 2);
-		type.second.height = thingsdata.GetWord(type.first + 4);
-		type.second.health = thingsdata.GetWord(type.first + 12);
+		DataReader header = things.GetRecord(id, 22);
 
-		auto resource = gfx_resources_.find(blocks_identifier);
-		type.second.resource_name = (resource == gfx_resources_.end()) ? "" : resource->second;
+		unsigned short blocks_identifier = header.GetWord(0);
 
-		if (resource == gfx_resources_.end()) {
+		type.width = header.GetWord(2);
+		type.height = header.GetWord(4);
+		type.health = header.GetWord(12);
+
+		auto resource = gfx_resources_.find(blocks_identifier);
+		if (resource == gfx_resources_.end())
 			std::cerr << "Warning: no resource name for object type " << blocks_identifier << std::endl;
-		}
+		else
+			resource->second.copy(type.resource_name, sizeof(type.resource_name));
 
-		int block_matrix_offset = thingsdata.GetWord(type.first + 6);
+		int num_blocks = (type.width / 16) * (type.height / 16);
+		DataReader block_matrix = things.GetRecord(header.GetWord(6), num_blocks * 2);
 
-		for (int nblock = 0; nblock < (type.second.width / 16) * (type.second.height / 16); nblock++)
-			type.second.blocks.push_back(thingsdata.GetWord(block_matrix_offset + nblock * 2));
+		type.first_block = blocks.size();
+		for (int nblock = 0; nblock < num_blocks; nblock++)
+			blocks.push_back(block_matrix.GetWord(nblock * 2));
+		type.num_blocks = num_blocks;
 
-		int nbboxes = thingsdata.GetWord(type.first + 20);
+		int nbboxes = header.GetWord(20);
+		DataReader bbox_records = things.GetRecord(id + 22, nbboxes * 12);
 
+		type.first_bbox = bboxes.size();
 		for (int nbbox = 0; nbbox < nbboxes; nbbox++) {
-			int bbox_offset = type.first + 22 + nbbox * 12;
+			int bbox_offset = nbbox * 12;
 			BuildingType::BBox bbox;
-			bbox.y1 = thingsdata.GetWord(bbox_offset + 0);
-			bbox.x1 = thingsdata.GetWord(bbox_offset + 2);
-			bbox.y2 = thingsdata.GetWord(bbox_offset + 4);
-			bbox.x2 = thingsdata.GetWord(bbox_offset + 6);
-			bbox.z1 = thingsdata.GetWord(bbox_offset + 8);
-			bbox.z2 = thingsdata.GetWord(bbox_offset + 10);
-
-			type.second.bboxes.emplace_back(bbox);
+			bbox.y1 = bbox_records.GetSWord(bbox_offset + 0);
+			bbox.x1 = bbox_records.GetSWord(bbox_offset + 2);
+			bbox.y2 = bbox_records.GetSWord(bbox_offset + 4);
+			bbox.x2 = bbox_records.GetSWord(bbox_offset + 6);
+			bbox.z1 = bbox_records.GetSWord(bbox_offset + 8);
+			bbox.z2 = bbox_records.GetSWord(bbox_offset + 10);
+
+			bboxes.emplace_back(bbox);
 		}
+		type.num_bboxes = nbboxes;
+
+		building_types.emplace_back(type);
+	}
+
+	//
+	// Pack everything into image
+	//
+	ImageHeader header = {};
+	std::copy(image_magic_, image_magic_ + sizeof(image_magic_), header.magic);
+	header.source_checksum = source_checksum;
+	header.width_blocks = width_blocks;
+	header.height_blocks = height_blocks;
+	header.num_building_instances = building_instances.size();
+	header.num_unit_instances = unit_instances.size();
+	header.num_building_types = building_types.size();
+	header.num_blocks = blocks.size();
+	header.num_bboxes = bboxes.size();
+
+	ImageLayout layout = GetImageLayout(header);
+
+	std::unique_ptr<Buffer> image(new Buffer);
+	image->Reserve(layout.size);
+
+	auto append = [&image](size_t offset, const void* data, size_t size) {
+		image->Append((unsigned char)0, offset - image->GetSize()); // alignment
+		image->Append(reinterpret_cast<const unsigned char*>(data), size);
+	};
+
+	append(0, &header, sizeof(header));
+	append(layout.building_instances_offset, building_instances.data(), building_instances.size() * sizeof(BuildingInstance));
+	append(layout.unit_instances_offset, unit_instances.data(), unit_instances.size() * sizeof(UnitInstance));
+	append(layout.building_types_offset, building_types.data(), building_types.size() * sizeof(BuildingTypeRecord));
+	append(layout.blocks_offset, blocks.data(), blocks.size() * sizeof(unsigned short));
+	append(layout.bboxes_offset, bboxes.data(), bboxes.size() * sizeof(BuildingType::BBox));
+	image->Append((unsigned char)0, layout.size - image->GetSize());
+
+	UseImage(std::move(image), width_blocks, height_blocks);
+}
+
+DatLevel::DatLevel(std::unique_ptr<MemRange>&& image, int width_blocks, int height_blocks) {
+	UseImage(std::move(image), width_blocks, height_blocks);
+}
+
+DatLevel::ImageLayout DatLevel::GetImageLayout(const ImageHeader& header) {
+	// arrays are aligned to allow direct access
+	auto align = [](size_t offset) {
+		return (offset + 7) & ~(size_t)7;
+	};
+
+	ImageLayout layout;
+	layout.building_instances_offset = align(sizeof(ImageHeader));
+	layout.unit_instances_offset = align(layout.building_instances_offset + header.num_building_instances * sizeof(BuildingInstance));
+	layout.building_types_offset = align(layout.unit_instances_offset + header.num_unit_instances * sizeof(UnitInstance));
+	layout.blocks_offset = align(layout.building_types_offset + header.num_building_types * sizeof(BuildingTypeRecord));
+	layout.bboxes_offset = align(layout.blocks_offset + header.num_blocks * sizeof(unsigned short));
+	layout.size = align(layout.bboxes_offset + header.num_bboxes * sizeof(BuildingType::BBox));
+	return layout;
+}
+
+void DatLevel::UseImage(std::unique_ptr<MemRange>&& image, int width_blocks, int height_blocks) {
+	const unsigned char* data = image->GetData();
+
+	if (image->GetSize() < sizeof(ImageHeader))
+		throw std::runtime_error("level image is too short");
+	if (reinterpret_cast<uintptr_t>(data) % alignof(ImageHeader) != 0)
+		throw std::runtime_error("level image is not aligned");
+
+	const ImageHeader& header = *reinterpret_cast<const ImageHeader*>(data);
+
+	if (!std::equal(image_magic_, image_magic_ + sizeof(image_magic_), header.magic))
+		throw std::runtime_error("bad level image magic");
+	if (header.width_blocks != (uint32_t)width_blocks || header.height_blocks != (uint32_t)height_blocks)
+		throw std::runtime_error("level image dimensions mismatch");
+
+	ImageLayout layout = GetImageLayout(header);
+	if (layout.size != image->GetSize())
+		throw std::runtime_error("level image size mismatch");
+
+	std::span<const BuildingTypeRecord> type_records(reinterpret_cast<const BuildingTypeRecord*>(data + layout.building_types_offset), header.num_building_types);
+	std::span<const unsigned short> blocks(reinterpret_cast<const unsigned short*>(data + layout.blocks_offset), header.num_blocks);
+	std::span<const BuildingType::BBox> bboxes(reinterpret_cast<const BuildingType::BBox*>(data + layout.bboxes_offset), header.num_bboxes);
+
+	building_type_ids_.clear();
+	building_types_.clear();
+	for (auto& record : type_records) {
+		if ((uint64_t)record.first_block + record.num_blocks > blocks.size() || (uint64_t)record.first_bbox + record.num_bboxes > bboxes.size())
+			throw std::runtime_error("level image is corrupt");
+		if (!building_type_ids_.empty() && record.id <= building_type_ids_.back())
+			throw std::runtime_error("level image is corrupt");
+
+		BuildingType type;
+		type.width = record.width;
+		type.height = record.height;
+		type.health = record.health;
+		type.resource_name.assign(record.resource_name, strnlen(record.resource_name, sizeof(record.resource_name)));
+		type.blocks = blocks.subspan(record.first_block, record.num_blocks);
+		type.bboxes = bboxes.subspan(record.first_bbox, record.num_bboxes);
+
+		building_type_ids_.push_back(record.id);
+		building_types_.emplace_back(type);
 	}
+
+	building_instances_ = std::span<const BuildingInstance>(reinterpret_cast<const BuildingInstance*>(data + layout.building_instances_offset), header.num_building_instances);
+	unit_instances_ = std::span<const UnitInstance>(reinterpret_cast<const UnitInstance*>(data + layout.unit_instances_offset), header.num_unit_instances);
+
+	// throws for unknown types
+	for (auto& bi : building_instances_) {
+		GetBuildingType(bi.type);
+		if (bi.dead_type)
+			GetBuildingType(bi.dead_type);
+	}
+
+	source_checksum_ = header.source_checksum;
+	image_ = std::move(image);
+}
+
+const MemRange& DatLevel::GetImage() const {
+	return *image_;
+}
+
+uint64_t DatLevel::GetSourceChecksum() const {
+	return source_checksum_;
 }
 
 void DatLevel::ForeachBuildingInstance(const BuildingInstanceProcessor& fn) const {
@@ -197,8 +360,8 @@ void DatLevel::ForeachBuildingInstance(const BuildingInstanceProcessor& fn) cons
 }
 
 void DatLevel::ForeachBuildingType(const BuildingTypeProcessor& fn) const {
-	for (auto& bt : building_types_)
-		fn(bt.first, bt.second);
+	for (size_t i = 0; i < building_types_.size(); i++)
+		fn(building_type_ids_[i], building_types_[i]);
 }
 
 void DatLevel::ForeachUnitInstance(const UnitInstanceProcessor& fn) const {
@@ -207,8 +370,8 @@ void DatLevel::ForeachUnitInstance(const UnitInstanceProcessor& fn) const {
 }
 
 const DatLevel::BuildingType& DatLevel::GetBuildingType(unsigned short type) const {
-	auto it = building_types_.find(type);
-	if (it == building_types_.end())
+	auto it = std::lower_bound(building_type_ids_.begin(), building_type_ids_.end(), type);
+	if (it == building_type_ids_.end() || *it != type)
 		throw std::runtime_error("unknown building type");
-	return it->second;
+	return building_types_[it - building_type_ids_.begin()];
 }
@@ -21,14 +21,20 @@
 #define DATLEVEL_HH
 
 #include <vector>
-#include <list>
 #include <map>
+#include <memory>
+#include <span>
+#include <string>
 #include <functional>
+#include <cstdint>
 
 #include <dat/buffer.hh>
 
 class MemRange;
 
+// Level contents are kept in a compact image of flat arrays, which
+// may be saved and later used in place (e.g. mapped from a file)
+// instead of parsing the level again
 class DatLevel {
 public:
 	struct BuildingInstance {
@@ -42,7 +48,7 @@ public:
 		signed short dead_sprite_x;
 		signed short dead_sprite_y;
 
-		BuildingInstance() : dead_type(0) {
+		BuildingInstance() : dead_type(0), dead_sprite_x(0), dead_sprite_y(0) {
 		}
 	};
 
@@ -60,8 +66,9 @@ public:
 
 		std::string resource_name;
 
-		std::vector<unsigned short> blocks;
-		std::vector<BBox> bboxes;
+		// point into level image
+		std::span<const unsigned short> blocks;
+		std::span<const BBox> bboxes;
 	};
 
 	struct UnitInstance {
@@ -75,16 +82,75 @@ public:
 
 	typedef std::function<void(const UnitInstance&)> UnitInstanceProcessor;
 
+protected:
+	// image is only meant to be read by the same build which
+	// wrote it, so it uses native layout and byte order
+	struct ImageHeader {
+		char magic[8];
+		uint64_t source_checksum;
+		uint32_t width_blocks;
+		uint32_t height_blocks;
+		uint32_t num_building_instances;
+		uint32_t num_unit_instances;
+		uint32_t num_building_types;
+		uint32_t num_blocks;
+		uint32_t num_bboxes;
+		uint32_t reserved;
+	};
+
+	// sorted by id
+	struct BuildingTypeRecord {
+		unsigned short id;
+		unsigned short width;
+		unsigned short height;
+		unsigned short health;
+		char resource_name[8]; // not terminated if 8 chars long
+		uint32_t first_block;
+		uint32_t num_blocks;
+		uint32_t first_bbox;
+		uint32_t num_bboxes;
+	};
+
+	struct ImageLayout {
+		size_t building_instances_offset;
+		size_t unit_instances_offset;
+		size_t building_types_offset;
+		size_t blocks_offset;
+		size_t bboxes_offset;
+		size_t size;
+	};
+
 protected:
 	const static std::map<unsigned short, std::string> gfx_resources_;
+	const static char image_magic_[8];
 
 protected:
-	std::list<BuildingInstance> building_instances_;
-	std::map<unsigned int, BuildingType> building_types_;
-	std::list<UnitInstance> unit_instances_;
+	std::unique_ptr<MemRange> image_;
+
+	std::span<const BuildingInstance> building_instances_;
+	std::span<const UnitInstance> unit_instances_;
+
+	// id to index table for building_types_
+	std::vector<unsigned short> building_type_ids_;
+	std::vector<BuildingType> building_types_;
+
+	uint64_t source_checksum_;
+
+protected:
+	static ImageLayout GetImageLayout(const ImageHeader& header);
+
+	void UseImage(std::unique_ptr<MemRange>&& image, int width_blocks, int height_blocks);
 
 public:
-	DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int width_blocks, int height_blocks);
+	// source checksum is stored in the image, e.g. to check
+	// whether it's still up to date with .DAT file
+	DatLevel(const MemRange& leveldata, const MemRange& thingsdata, int width_blocks, int height_blocks, uint64_t source_checksum = 0);
+
+	// throws if image is not valid or has different size
+	DatLevel(std::unique_ptr<MemRange>&& image, int width_blocks, int height_blocks);
+
+	const MemRange& GetImage() const;
+	uint64_t GetSourceChecksum() const;
 
 	void ForeachBuildingInstance(const BuildingInstanceProcessor& fn) const;
 	void ForeachBuildingType(const BuildingTypeProcessor& fn) const;
@@ -0,0 +1,73 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdexcept>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <dat/mappedfile.hh>
+
+MappedFile::MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd == -1)
+		throw std::runtime_error("cannot open " + path + ": " + std::strerror(errno));
+
+	struct stat st;
+	if (fstat(fd, &st) == -1) {
+		int saved_errno = errno;
+		close(fd);
+		throw std::runtime_error("cannot stat " + path + ": " + std::strerror(saved_errno));
+	}
+
+	// mmap() refuses zero length, and there's nothing to map anyway
+	if (st.st_size == 0) {
+		close(fd);
+		return;
+	}
+
+	void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	int saved_errno = errno;
+
+	// mapping stays valid after the descriptor is closed
+	close(fd);
+
+	if (mapping == MAP_FAILED)
+		throw std::runtime_error("cannot mmap " + path + ": " + std::strerror(saved_errno));
+
+	data_ = static_cast<const unsigned char*>(mapping);
+	size_ = st.st_size;
+}
+
+MappedFile::~MappedFile() {
+	if (data_ != nullptr)
+		munmap(const_cast<unsigned char*>(data_), size_);
+}
+
+const unsigned char* MappedFile::GetData() const {
+	return data_;
+}
+
+size_t MappedFile::GetSize() const {
+	return size_;
+}
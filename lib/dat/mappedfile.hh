@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MAPPEDFILE_HH
+#define MAPPEDFILE_HH
+
+#include <string>
+
+#include <dat/buffer.hh>
+
+class MappedFile : public MemRange {
+protected:
+	const unsigned char* data_;
+	size_t size_;
+
+public:
+	MappedFile(const std::string& path);
+	virtual ~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	virtual const unsigned char* GetData() const;
+	virtual size_t GetSize() const;
+};
+
+#endif // MAPPEDFILE_HH
@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <limits>
 #include <stdexcept>
 
 #include <dat/buffer.hh>
@@ -30,6 +31,83 @@ void Unpacker::ResetTable() {
 		table_[i * 4] = i;
 }
 
+void Unpacker::ExpandTable() {
+	enum { NEW, VISITING, DONE };
+	unsigned char state[256];
+	std::fill(state, state + 256, NEW);
+
+	expanded_ = false;
+	expansions_.clear();
+
+	// appends one half of a pair: either a literal byte or
+	// (already expanded) contents of another symbol
+	auto append_part = [this](unsigned char flag, unsigned char value) {
+		if (flag == 1) {
+			expansions_.push_back(value);
+			return true;
+		}
+
+		size_t pos = expansions_.size();
+		if (pos + expansion_lengths_[value] > max_expansions_size_)
+			return false;
+
+		expansions_.resize(pos + expansion_lengths_[value]);
+		std::copy_n(expansions_.begin() + expansion_offsets_[value], expansion_lengths_[value], expansions_.begin() + pos);
+		return true;
+	};
+
+	// depth-first walk over pair references without recursion; each
+	// symbol is expanded after both of its halves, and the stack
+	// only holds symbols which are being visited, so it can't be
+	// deeper than the number of symbols
+	unsigned char stack[256];
+	for (int root = 0; root < 256; root++) {
+		if (state[root] == DONE)
+			continue;
+
+		int depth = 0;
+		stack[depth++] = root;
+		state[root] = VISITING;
+
+		while (depth > 0) {
+			unsigned char sym = stack[depth - 1];
+
+			int pending = -1;
+			if (table_[sym * 4 + 1] != 0) {
+				if (table_[sym * 4 + 3] != 1 && state[table_[sym * 4 + 2]] != DONE)
+					pending = table_[sym * 4 + 2];
+				else if (table_[sym * 4 + 1] != 1 && state[table_[sym * 4]] != DONE)
+					pending = table_[sym * 4];
+			}
+
+			if (pending != -1) {
+				// circular table; leave it to the recursive path
+				if (state[pending] == VISITING)
+					return;
+
+				state[pending] = VISITING;
+				stack[depth++] = pending;
+				continue;
+			}
+
+			expansion_offsets_[sym] = expansions_.size();
+
+			if (table_[sym * 4 + 1] == 0) {
+				expansions_.push_back(table_[sym * 4]);
+			} else if (!append_part(table_[sym * 4 + 3], table_[sym * 4 + 2]) || !append_part(table_[sym * 4 + 1], table_[sym * 4])) {
+				// too large; leave it to the recursive path
+				return;
+			}
+
+			expansion_lengths_[sym] = expansions_.size() - expansion_offsets_[sym];
+			state[sym] = DONE;
+			depth--;
+		}
+	}
+
+	expanded_ = true;
+}
+
 void Unpacker::ProcessEscape(unsigned char in) {
 	if (in == 0) {
 		in_state_ = END_OF_FILE;
@@ -92,14 +170,42 @@ void Unpacker::OutputByte(unsigned char in, Buffer& out) {
 	}
 }
 
-Unpacker::Unpacker(): in_state_(READ_TABLE_SIZE), out_state_(OUT_ESCAPED), counter_(0) {
+void Unpacker::OutputBytes(const unsigned char* in, size_t size, Buffer& out) {
+	while (size > 0) {
+		if (out_state_ == OUT_SINGLE) {
+			// note that zero counter never expires, same as in OutputByte
+			size_t count = (counter_ > 0 && (size_t)counter_ < size) ? counter_ : size;
+
+			out.Append(in, count);
+			counter_ -= (int)count;
+			if (counter_ == 0)
+				out_state_ = OUT_ESCAPED;
+
+			in += count;
+			size -= count;
+		} else if (out_state_ == OUT_RLE) {
+			out.Append(*in++, counter_);
+			out_state_ = OUT_ESCAPED;
+			size--;
+		} else {
+			OutputByte(*in++, out);
+			size--;
+		}
+	}
 }
 
-void Unpacker::Process(const MemRange& in, Buffer& out) {
-	for (const unsigned char* i = in.GetData(); i != in.GetData() + in.GetSize(); i++) {
+Unpacker::Unpacker(Mode mode): in_state_(READ_TABLE_SIZE), out_state_(OUT_ESCAPED), counter_(0), mode_(mode), expanded_(false), pending_pos_(0) {
+}
+
+const unsigned char* Unpacker::Feed(const unsigned char* begin, const unsigned char* end, Buffer& out, size_t out_limit) {
+	for (const unsigned char* i = begin; i != end; i++) {
+		if (out.GetSize() >= out_limit)
+			return i;
+
 		switch (in_state_) {
 		case READ_TABLE_SIZE:
 			table_size_ = *i;
+			expanded_ = false;
 			ResetTable();
 			in_state_ = READ_ESCAPE_CHAR;
 			break;
@@ -127,10 +233,13 @@ void Unpacker::Process(const MemRange& in, Buffer& out) {
 			table_[table_first_ * 4 + 1] = table_[*i * 4 + 1] ? 2 : 1;
 			table_[table_first_ * 4] = *i;
 
-			if (--table_size_ == 0)
+			if (--table_size_ == 0) {
 				in_state_ = READ_BYTE;
-			else
+				if (mode_ == EXPANDED)
+					ExpandTable();
+			} else {
 				in_state_ = READ_TABLE_FIRST;
+			}
 
 			break;
 
@@ -143,20 +252,57 @@ void Unpacker::Process(const MemRange& in, Buffer& out) {
 		case READ_BYTE:
 			if (*i == escape_char_)
 				in_state_ = READ_ESCAPED;
+			else if (expanded_)
+				OutputBytes(expansions_.data() + expansion_offsets_[*i], expansion_lengths_[*i], out);
 			else
 				ProcessByte(*i, out);
 
 			break;
 
 		case READ_BYTE_ONLY:
-			OutputByte(*i, out);
+			if (mode_ == EXPANDED && out_state_ == OUT_SINGLE) {
+				// copy whole literal run at once
+				size_t count = (counter_ > 0 && (size_t)counter_ < (size_t)(end - i)) ? counter_ : end - i;
+				count = std::min(count, out_limit - out.GetSize());
+				OutputBytes(i, count, out);
+				i += count - 1;
+			} else {
+				OutputByte(*i, out);
+			}
 			break;
 
 		case END_OF_FILE:
-			return;
+			return i;
 		}
 	}
 
+	return end;
+}
+
+void Unpacker::Process(const MemRange& in, Buffer& out) {
+	Feed(in.GetData(), in.GetData() + in.GetSize(), out, std::numeric_limits<size_t>::max());
+
 	if (in_state_ != END_OF_FILE)
 		throw std::logic_error("unexpected end of data");
 }
+
+size_t Unpacker::Push(const unsigned char* in, size_t size) {
+	if (pending_pos_ != pending_.GetSize())
+		return 0;
+
+	pending_.Clear();
+	pending_pos_ = 0;
+
+	return Feed(in, in + size, pending_, max_pending_size_) - in;
+}
+
+size_t Unpacker::Pull(unsigned char* out, size_t size) {
+	size_t count = std::min(size, pending_.GetSize() - pending_pos_);
+	std::copy_n(pending_.GetData() + pending_pos_, count, out);
+	pending_pos_ += count;
+	return count;
+}
+
+bool Unpacker::IsFinished() const {
+	return in_state_ == END_OF_FILE && pending_pos_ == pending_.GetSize();
+}
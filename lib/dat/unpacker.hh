@@ -20,10 +20,18 @@
 #ifndef UNPACKER_HH
 #define UNPACKER_HH
 
-class Buffer;
-class MemRange;
+#include <vector>
+#include <cstddef>
+
+#include <dat/buffer.hh>
 
 class Unpacker {
+public:
+	enum Mode {
+		RECURSIVE, // expand dictionary pairs recursively for each input byte
+		EXPANDED,  // expand whole dictionary once, then emit runs of bytes
+	};
+
 private:
 	enum InState {
 		READ_TABLE_SIZE,
@@ -61,15 +69,54 @@ private:
 	unsigned char table_second_;
 	int counter_;
 
+	Mode mode_;
+
+	// flat expansions of all 256 symbols for current table,
+	// valid only when expanded_ is set
+	bool expanded_;
+	std::vector<unsigned char> expansions_;
+	size_t expansion_offsets_[256];
+	size_t expansion_lengths_[256];
+
+	// when dictionary expands to more than this, it's processed
+	// recursively instead
+	static const size_t max_expansions_size_ = 1024 * 1024;
+
+	// output produced by Push() and not yet taken by Pull()
+	Buffer pending_;
+	size_t pending_pos_;
+
+	// Push() stops consuming input when this much output is pending;
+	// single input byte may still produce more than that
+	static const size_t max_pending_size_ = 64 * 1024;
+
 private:
 	void ResetTable();
+	void ExpandTable();
 	void ProcessEscape(unsigned char in);
 	void ProcessByte(unsigned char in, Buffer& out);
 	void OutputByte(unsigned char in, Buffer& out);
+	void OutputBytes(const unsigned char* in, size_t size, Buffer& out);
+
+	// consumes input until its end, end of packed data, or until
+	// output reaches given size; returns end of consumed input
+	const unsigned char* Feed(const unsigned char* begin, const unsigned char* end, Buffer& out, size_t out_limit);
 
 public:
-	Unpacker();
+	Unpacker(Mode mode = EXPANDED);
+
+	// unpacks whole data at once
 	void Process(const MemRange& in, Buffer& out);
+
+	// Streaming interface: input may be pushed in pieces of any size,
+	// output is pulled into caller buffers. Push() only consumes
+	// input when all previous output was pulled, and returns number
+	// of bytes consumed; the rest should be pushed again later
+	size_t Push(const unsigned char* in, size_t size);
+	size_t Pull(unsigned char* out, size_t size);
+
+	// end of packed data was reached and all output was pulled
+	bool IsFinished() const;
 };
 
 #endif // UNPACKER_HH
@@ -0,0 +1,166 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef COMMANDBUFFER_HH
+#define COMMANDBUFFER_HH
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <utility>
+#include <type_traits>
+
+// Sequence of commands (callables of any type) to be run later in
+// the order they were added; commands are stored inline in fixed
+// size blocks which are kept when buffer is cleared, so once it has
+// grown to the usual size, adding commands does not allocate
+class CommandBuffer {
+protected:
+	static constexpr size_t block_size_ = 4096;
+	static constexpr size_t alignment_ = alignof(std::max_align_t);
+
+	// runs command (if run is set) and destroys it
+	typedef void (*Handler)(void* command, bool run);
+
+	struct Header {
+		Handler handler;
+		size_t size; // of whole record
+	};
+
+	struct Block {
+		alignas(std::max_align_t) unsigned char data[block_size_];
+		size_t used;
+
+		Block() : used(0) {
+		}
+	};
+
+	typedef std::vector<std::unique_ptr<Block>> BlockVector;
+
+protected:
+	static constexpr size_t header_size_ = (sizeof(Header) + alignment_ - 1) / alignment_ * alignment_;
+
+	BlockVector blocks_;
+	size_t current_block_;
+
+protected:
+	template<class F>
+	static void Handle(void* command, bool run) {
+		F* function = std::launder(static_cast<F*>(command));
+
+		struct Destroyer {
+			F* function;
+			~Destroyer() {
+				function->~F();
+			}
+		} destroyer{function};
+
+		if (run)
+			(*function)();
+	}
+
+	// destroys commands without running them, starting from
+	// given position, and forgets all commands
+	void Discard(size_t nblock, size_t offset) {
+		for (; nblock < blocks_.size(); nblock++, offset = 0) {
+			Block& block = *blocks_[nblock];
+			while (offset < block.used) {
+				Header* header = std::launder(reinterpret_cast<Header*>(block.data + offset));
+				header->handler(block.data + offset + header_size_, false);
+				offset += header->size;
+			}
+			block.used = 0;
+		}
+		current_block_ = 0;
+	}
+
+public:
+	CommandBuffer() : current_block_(0) {
+	}
+
+	~CommandBuffer() {
+		Discard(0, 0);
+	}
+
+	CommandBuffer(const CommandBuffer&) = delete;
+	CommandBuffer& operator=(const CommandBuffer&) = delete;
+
+	CommandBuffer(CommandBuffer&& other) noexcept : blocks_(std::move(other.blocks_)), current_block_(other.current_block_) {
+		other.blocks_.clear();
+		other.current_block_ = 0;
+	}
+
+	CommandBuffer& operator=(CommandBuffer&& other) noexcept {
+		Discard(0, 0);
+		blocks_ = std::move(other.blocks_);
+		current_block_ = other.current_block_;
+		other.blocks_.clear();
+		other.current_block_ = 0;
+		return *this;
+	}
+
+	template<class F>
+	void Add(F&& command) {
+		typedef std::decay_t<F> Function;
+		static constexpr size_t size = header_size_ + (sizeof(Function) + alignment_ - 1) / alignment_ * alignment_;
+
+		static_assert(size <= block_size_, "command is too large");
+		static_assert(alignof(Function) <= alignment_, "command is overaligned");
+
+		if (current_block_ < blocks_.size() && blocks_[current_block_]->used + size > block_size_)
+			current_block_++;
+		if (current_block_ == blocks_.size())
+			blocks_.emplace_back(new Block);
+
+		Block& block = *blocks_[current_block_];
+		unsigned char* record = block.data + block.used;
+
+		new (record + header_size_) Function(std::forward<F>(command));
+		new (record) Header{&Handle<Function>, size};
+		block.used += size;
+	}
+
+	// runs all commands in order and clears the buffer; if a
+	// command throws, the rest are destroyed without running
+	void Run() {
+		for (size_t nblock = 0; nblock < blocks_.size(); nblock++) {
+			Block& block = *blocks_[nblock];
+			for (size_t offset = 0; offset < block.used; ) {
+				Header* header = std::launder(reinterpret_cast<Header*>(block.data + offset));
+				size_t next = offset + header->size;
+				try {
+					header->handler(block.data + offset + header_size_, true);
+				} catch (...) {
+					Discard(nblock, next);
+					throw;
+				}
+				offset = next;
+			}
+			block.used = 0;
+		}
+		current_block_ = 0;
+	}
+
+	void Clear() {
+		Discard(0, 0);
+	}
+};
+
+#endif // COMMANDBUFFER_HH
@@ -17,13 +17,20 @@
  * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <cassert>
+#include <atomic>
+#include <algorithm>
 
 #include <game/gameobject.hh>
 
 #include <game/game.hh>
 
-Game::Game(float width, float height) : width_(width), height_(height) {
+// buffer for commands deferred by objects being updated by this thread
+static thread_local CommandBuffer* deferred_commands = nullptr;
+
+const float Game::grid_cell_size_ = 128.0f;
+const unsigned int Game::default_tick_ms_ = 10;
+
+Game::Game(float width, float height) : width_(width), height_(height), generation_(NewGeneration()), grid_(width, height, grid_cell_size_), updating_(false), tick_ms_(default_tick_ms_), accumulated_ms_(0) {
 }
 
 Game::~Game() {
@@ -45,15 +52,31 @@ Game& Game::operator=(Game&& other) noexcept = default;
 Game::Game(Game&& other) noexcept
 	: width_(other.width_),
 	  height_(other.height_),
-	  objects_(std::move(other.objects_)),
-	  for_removal_(std::move(other.for_removal_)) {
+	  generation_(other.generation_),
+	  pools_(std::move(other.pools_)),
+	  for_removal_(std::move(other.for_removal_)),
+	  grid_(std::move(other.grid_)),
+	  updating_(other.updating_),
+	  tick_ms_(other.tick_ms_),
+	  accumulated_ms_(other.accumulated_ms_),
+	  workers_(std::move(other.workers_)),
+	  work_items_(std::move(other.work_items_)),
+	  command_buffers_(std::move(other.command_buffers_)) {
 }
 
 Game& Game::operator=(Game&& other) noexcept {
 	width_ = other.width_;
 	height_ = other.height_;
-	objects_ = std::move(other.objects_);
+	generation_ = other.generation_;
+	pools_ = std::move(other.pools_);
 	for_removal_ = std::move(other.for_removal_);
+	grid_ = std::move(other.grid_);
+	updating_ = other.updating_;
+	tick_ms_ = other.tick_ms_;
+	accumulated_ms_ = other.accumulated_ms_;
+	workers_ = std::move(other.workers_);
+	work_items_ = std::move(other.work_items_);
+	command_buffers_ = std::move(other.command_buffers_);
 	return *this;
 }
 
@@ -61,39 +84,149 @@ void Game::Accept(Visitor& visitor) {
 	// remove objects that were scheduled from outside
 	RemoveScheduledObjects();
 
-	for (ObjectList::iterator object = objects_.begin(); object != objects_.end(); object++)
-		(*object)->Accept(visitor);
+	for (auto& pool : pools_)
+		if (pool)
+			pool->Accept(visitor);
 }
 
 void Game::Update(unsigned int deltams) {
 	// remove objects that were scheduled from outside
 	RemoveScheduledObjects();
 
-	for (ObjectList::iterator object = objects_.begin(); object != objects_.end(); object++)
-		(*object)->Update(deltams);
+	updating_ = true;
+
+	work_items_.clear();
+	for (auto& pool : pools_)
+		if (pool)
+			for (size_t nchunk = 0; nchunk < pool->GetNumChunks(); nchunk++)
+				work_items_.emplace_back(pool.get(), nchunk);
+
+	if (command_buffers_.size() < work_items_.size())
+		command_buffers_.resize(work_items_.size());
+
+	// update objects, which only changes their own state
+	auto job = [this, deltams](size_t item) {
+		deferred_commands = &command_buffers_[item];
+		try {
+			work_items_[item].first->UpdateChunk(work_items_[item].second, deltams);
+		} catch (...) {
+			deferred_commands = nullptr;
+			throw;
+		}
+		deferred_commands = nullptr;
+	};
+
+	if (workers_)
+		workers_->Run(work_items_.size(), job);
+	else
+		for (size_t item = 0; item < work_items_.size(); item++)
+			job(item);
+
+	// apply everything else
+	for (size_t item = 0; item < work_items_.size(); item++)
+		command_buffers_[item].Run();
+
+	updating_ = false;
 
 	// remove objects that were scheduled during update
 	RemoveScheduledObjects();
+
+	for (auto& pool : pools_)
+		if (pool)
+			pool->ActivateSpawned();
+}
+
+unsigned int Game::Advance(unsigned int deltams, unsigned int max_ticks) {
+	accumulated_ms_ += deltams;
+
+	unsigned int ticks = 0;
+	for (; accumulated_ms_ >= tick_ms_ && ticks < max_ticks; ticks++) {
+		Update(tick_ms_);
+		accumulated_ms_ -= tick_ms_;
+	}
+
+	// can't keep up
+	if (accumulated_ms_ >= tick_ms_)
+		accumulated_ms_ %= tick_ms_;
+
+	return ticks;
+}
+
+void Game::SetTickLength(unsigned int ms) {
+	tick_ms_ = std::max(ms, 1u);
+	accumulated_ms_ = std::min(accumulated_ms_, tick_ms_ - 1);
+}
+
+unsigned int Game::GetTickLength() const {
+	return tick_ms_;
+}
+
+float Game::GetInterpolation() const {
+	return (float)accumulated_ms_ / tick_ms_;
+}
+
+void Game::AddToGrid(GameObject* object, const Vector2f& min, const Vector2f& max) {
+	grid_.Insert(object, min, max);
+	object->in_grid_ = true;
 }
 
-void Game::RemoveLater(const GameObject* victim) {
-	// note: only inserts once, e.g. no object will be removed twice
-	for_removal_.insert(victim);
+void Game::AcceptInArea(Visitor& visitor, const Vector2f& min, const Vector2f& max) {
+	grid_.ForeachInArea(min, max, [&visitor](GameObject& object) {
+		object.Accept(visitor);
+	});
+}
+
+bool Game::IsDeferring() {
+	return deferred_commands != nullptr;
+}
+
+CommandBuffer* Game::GetDeferredCommands() {
+	return deferred_commands;
+}
+
+void Game::SetNumThreads(unsigned int num_threads) {
+	if (num_threads > 1)
+		workers_.reset(new WorkerPool(num_threads - 1));
+	else
+		workers_.reset();
+}
+
+void Game::RemoveLater(GameObject* victim) {
+	if (deferred_commands) {
+		Defer([this, victim]() { RemoveLater(victim); });
+		return;
+	}
+
+	// note: only added once, e.g. no object will be removed twice
+	if (!victim->removal_scheduled_) {
+		victim->removal_scheduled_ = true;
+		for_removal_.push_back(victim);
+	}
 }
 
 void Game::RemoveScheduledObjects() {
-	if (for_removal_.empty())
+	// objects are never destroyed while being iterated
+	if (updating_ || for_removal_.empty())
 		return;
 
-	for (ObjectList::iterator object = objects_.begin(); object != objects_.end(); ) {
-		ObjectList::iterator current = object++;
-		RemovedObjectsSet::iterator victim = for_removal_.find(current->get());
-		if (victim != for_removal_.end()) {
-			for_removal_.erase(victim);
-			objects_.erase(current);
-		}
+	for (auto& victim : for_removal_) {
+		if (victim->in_grid_)
+			grid_.Remove(victim);
+
+		victim->pool_->Destroy(victim->pool_slot_);
 	}
-	assert(for_removal_.empty());
+
+	for_removal_.clear();
+}
+
+size_t Game::NewPoolIndex() {
+	static std::atomic<size_t> next_index(0);
+	return next_index++;
+}
+
+uint64_t Game::NewGeneration() {
+	static std::atomic<uint64_t> next_generation(1);
+	return next_generation++;
 }
 
 float Game::GetWidth() const {
@@ -103,3 +236,7 @@ float Game::GetWidth() const {
 float Game::GetHeight() const {
 	return height_;
 }
+
+uint64_t Game::GetGeneration() const {
+	return generation_;
+}
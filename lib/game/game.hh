@@ -21,28 +21,70 @@
 #define GAME_HH
 
 #include <game/gameobject.hh>
+#include <game/objectpool.hh>
+#include <game/commandbuffer.hh>
+#include <game/workerpool.hh>
 
+#include <math/geom.hh>
+#include <math/spatialgrid.hh>
+
+#include <cassert>
+#include <cstdint>
 #include <memory>
-#include <list>
-#include <set>
+#include <vector>
 #include <utility>
 
 class Visitor;
 
 class Game {
 protected:
-	typedef std::list<std::unique_ptr<GameObject>> ObjectList;
-	typedef std::set<const GameObject*> RemovedObjectsSet;
+	typedef std::vector<std::unique_ptr<ObjectPoolBase>> PoolVector;
+	typedef std::vector<GameObject*> RemovedObjectsVector;
+	typedef std::vector<std::pair<ObjectPoolBase*, size_t>> WorkItemVector; // pool and chunk
+	typedef SpatialGrid<GameObject> ObjectGrid;
+
+protected:
+	static const float grid_cell_size_;
+	static const unsigned int default_tick_ms_;
 
 protected:
 	float width_;
 	float height_;
-	ObjectList objects_;
-	RemovedObjectsSet for_removal_;
+	uint64_t generation_;
+	PoolVector pools_; // one per object type
+	RemovedObjectsVector for_removal_;
+	ObjectGrid grid_;
+	bool updating_;
+
+	unsigned int tick_ms_;
+	unsigned int accumulated_ms_;
+
+	// objects are updated in parallel by chunks of pools, each
+	// chunk has its own buffer for deferred commands
+	std::unique_ptr<WorkerPool> workers_;
+	WorkItemVector work_items_;
+	std::vector<CommandBuffer> command_buffers_;
 
 protected:
 	void RemoveScheduledObjects();
 
+	static size_t NewPoolIndex();
+	static uint64_t NewGeneration();
+	static bool IsDeferring();
+	static CommandBuffer* GetDeferredCommands();
+
+	template<class T>
+	ObjectPool<T>& GetPool() {
+		static const size_t index = NewPoolIndex();
+
+		if (index >= pools_.size())
+			pools_.resize(index + 1);
+		if (!pools_[index])
+			pools_[index].reset(new ObjectPool<T>);
+
+		return static_cast<ObjectPool<T>&>(*pools_[index]);
+	}
+
 public:
 	Game(float width, float height);
 	~Game();
@@ -53,7 +95,7 @@ public:
 	 * Default are safe however, while we only basically want to
 	 * delete copy constructor (copying will invalidate pointers in
 	 * for_removal_ and externally stored pointes), hover no copy
-	 * constructor is possible anyway as we have list of non-copyable
+	 * constructor is possible anyway as we have vector of non-copyable
 	 * std::unique_ptr
 	Game(const Game&) = delete;
 	Game& operator=(const Game&) = delete;
@@ -66,21 +108,74 @@ public:
 	Game(Game&&) noexcept;
 	Game& operator=(Game&&) noexcept;
 
+	// objects spawned during Update() are first updated on the next one
 	template<class T, class... Args>
 	T* Spawn(Args... args) {
-		T* ptr;
-		std::unique_ptr<GameObject> obj(ptr = new T(*this, std::forward<Args>(args)...));
-		objects_.push_back(std::move(obj));
-		return ptr;
+		assert(!IsDeferring()); // use SpawnLater() from GameObject::Update()
+		return GetPool<T>().Create(updating_, *this, std::forward<Args>(args)...);
+	}
+
+	// object which exists in single instance (e.g. a system handling
+	// many lightweight entities at once), spawned on first request
+	template<class T>
+	T& GetSingleton() {
+		if (T* object = GetPool<T>().GetFirst())
+			return *object;
+		return *Spawn<T>();
 	}
 
+	// objects are updated in parallel, so in GameObject::Update()
+	// they may only change their own state; anything else (spawning
+	// objects, affecting other objects) is done through these, and
+	// is applied after all objects are updated, in the same order
+	// as objects are stored, regardless of number of threads
+	template<class F>
+	void Defer(F&& command) {
+		if (CommandBuffer* commands = GetDeferredCommands())
+			commands->Add(std::forward<F>(command));
+		else
+			command();
+	}
+
+	template<class T, class... Args>
+	void SpawnLater(Args... args) {
+		Defer([this, args...]() {
+			Spawn<T>(args...);
+		});
+	}
+
+	// 1 updates objects in calling thread only
+	void SetNumThreads(unsigned int num_threads);
+
 	void Accept(Visitor& visitor);
 	void Update(unsigned int deltams);
 
-	void RemoveLater(const GameObject* victim);
+	// runs as many fixed length updates as fit into elapsed time
+	// plus time left from previous call, but no more than max_ticks
+	// (then the rest of time is dropped); returns number of updates
+	unsigned int Advance(unsigned int deltams, unsigned int max_ticks = 10);
+
+	void SetTickLength(unsigned int ms);
+	unsigned int GetTickLength() const;
+
+	// part of tick passed since the last update, for interpolating
+	// between previous and current states of objects when rendering
+	float GetInterpolation() const;
+
+	// static objects (e.g. buildings) register their ground extents
+	// here, so collision checks may only visit ones near given area
+	void AddToGrid(GameObject* object, const Vector2f& min, const Vector2f& max);
+	void AcceptInArea(Visitor& visitor, const Vector2f& min, const Vector2f& max);
+
+	void RemoveLater(GameObject* victim);
 
 	float GetWidth() const;
 	float GetHeight() const;
+
+	// unique for each constructed game and kept when game is moved,
+	// so caches of its contents (e.g. pre-rendered buildings) know
+	// when a different level was moved in
+	uint64_t GetGeneration() const;
 };
 
 #endif // GAME_HH
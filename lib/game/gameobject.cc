@@ -21,7 +21,7 @@
 
 #include <game/gameobject.hh>
 
-GameObject::GameObject(Game& game) : game_(game) {
+GameObject::GameObject(Game& game) : pool_(nullptr), pool_slot_(0), removal_scheduled_(false), in_grid_(false), game_(game) {
 }
 
 GameObject::~GameObject() {
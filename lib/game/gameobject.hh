@@ -20,10 +20,28 @@
 #ifndef GAMEOBJECT_HH
 #define GAMEOBJECT_HH
 
+#include <cstddef>
+
 class Game;
 class Visitor;
+class ObjectPoolBase;
+
+template<class T>
+class ObjectPool;
 
 class GameObject {
+private:
+	// bookkeeping of the game and its object pools, which
+	// makes removal of an object independent of world size
+	friend class Game;
+	template<class T>
+	friend class ObjectPool;
+
+	ObjectPoolBase* pool_;
+	size_t pool_slot_;
+	bool removal_scheduled_;
+	bool in_grid_;
+
 protected:
 	Game& game_;
 
@@ -18,10 +18,15 @@
  */
 
 #include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
 
 #include <dat/buffer.hh>
 #include <dat/datfile.hh>
 #include <dat/datlevel.hh>
+#include <dat/mappedfile.hh>
 
 #include <gameobjects/building.hh>
 #include <gameobjects/unit.hh>
@@ -31,13 +36,70 @@
 LevelLoader::LevelLoader() {
 }
 
+std::unique_ptr<DatLevel> LevelLoader::LoadCachedLevel(const std::string& path, uint64_t dat_checksum, int width_blocks, int height_blocks) {
+	std::unique_ptr<DatLevel> level;
+	try {
+		level.reset(new DatLevel(std::unique_ptr<MemRange>(new MappedFile(path)), width_blocks, height_blocks));
+	} catch (std::runtime_error&) {
+		return nullptr; // not created yet or invalid
+	}
+
+	if (level->GetSourceChecksum() != dat_checksum)
+		return nullptr;
+
+	return level;
+}
+
+void LevelLoader::SaveCachedLevel(const std::string& path, const DatLevel& level) {
+	const MemRange& image = level.GetImage();
+
+	// write to temporary file first, so concurrent or interrupted
+	// run never sees partially written cache
+	std::string temp_path = path + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+		file.write(reinterpret_cast<const char*>(image.GetData()), image.GetSize());
+
+		if (!file) {
+			std::cerr << "Warning: cannot write level cache " << temp_path << std::endl;
+			file.close();
+			std::remove(temp_path.c_str());
+			return;
+		}
+	}
+
+	if (std::rename(temp_path.c_str(), path.c_str()) != 0) {
+		std::cerr << "Warning: cannot write level cache " << path << std::endl;
+		std::remove(temp_path.c_str());
+	}
+}
+
 Game LevelLoader::Load(const DatFile& datfile, const std::string& levelname, int width_blocks, int height_blocks) {
 	Game game(width_blocks * 512, height_blocks * 1024);
 
-	Buffer level_data = datfile.GetData(levelname);
-	Buffer things_data = datfile.GetData("THINGS");
+	std::unique_ptr<DatLevel> cached_level;
+	std::string cache_path;
+	uint64_t dat_checksum = 0;
+	if (!cache_prefix_.empty()) {
+		// memoised by datfile, so only first load scans whole file
+		dat_checksum = datfile.GetChecksum();
+
+		cache_path = cache_prefix_ + levelname + ".level";
+		cached_level = LoadCachedLevel(cache_path, dat_checksum, width_blocks, height_blocks);
+	}
+
+	if (!cached_level) {
+		std::shared_ptr<const Buffer> level_data = datfile.GetData(levelname);
+		std::shared_ptr<const Buffer> things_data = datfile.GetData("THINGS");
 
-	DatLevel level(level_data, things_data, width_blocks, height_blocks);
+		cached_level.reset(new DatLevel(*level_data, *things_data, width_blocks, height_blocks, dat_checksum));
+
+		if (!cache_path.empty())
+			SaveCachedLevel(cache_path, *cached_level);
+	}
+
+	const DatLevel& level = *cached_level;
 
 	level.ForeachBuildingInstance([&game, &level](const DatLevel::BuildingInstance& bi) {
 		// this should have some geometrical meaning,
@@ -121,3 +183,7 @@ void LevelLoader::AddBuildingTypeProcessor(const DatLevel::BuildingTypeProcessor
 void LevelLoader::AddUnitInstanceProcessor(const DatLevel::UnitInstanceProcessor& fn) {
 	unit_instance_processors_.push_back(fn);
 }
+
+void LevelLoader::SetCachePrefix(const std::string& prefix) {
+	cache_prefix_ = prefix;
+}
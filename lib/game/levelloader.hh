@@ -22,6 +22,8 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <cstdint>
 
 #include <dat/datlevel.hh>
 
@@ -35,6 +37,12 @@ private:
 	std::vector<DatLevel::BuildingTypeProcessor> building_type_processors_;
 	std::vector<DatLevel::UnitInstanceProcessor> unit_instance_processors_;
 
+	std::string cache_prefix_;
+
+protected:
+	std::unique_ptr<DatLevel> LoadCachedLevel(const std::string& path, uint64_t dat_checksum, int width_blocks, int height_blocks);
+	void SaveCachedLevel(const std::string& path, const DatLevel& level);
+
 public:
 	LevelLoader();
 
@@ -42,6 +50,10 @@ public:
 	void AddBuildingTypeProcessor(const DatLevel::BuildingTypeProcessor& fn);
 	void AddUnitInstanceProcessor(const DatLevel::UnitInstanceProcessor& fn);
 
+	// parsed levels are saved as prefix + levelname + ".level"
+	// and reused while datfile stays the same
+	void SetCachePrefix(const std::string& prefix);
+
 	Game Load(const DatFile& datfile, const std::string& levelname, int width_blocks, int height_blocks);
 };
 
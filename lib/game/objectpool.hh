@@ -0,0 +1,174 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECTPOOL_HH
+#define OBJECTPOOL_HH
+
+#include <vector>
+#include <memory>
+#include <new>
+#include <utility>
+#include <algorithm>
+
+#include <game/gameobject.hh>
+
+class Visitor;
+
+class ObjectPoolBase {
+public:
+	virtual ~ObjectPoolBase() {
+	}
+
+	// process active objects; objects spawned during update
+	// are only visited by Accept() until ActivateSpawned()
+	virtual size_t GetNumChunks() const = 0;
+	virtual void UpdateChunk(size_t nchunk, unsigned int deltams) = 0;
+	virtual void Accept(Visitor& visitor) = 0;
+	virtual void ActivateSpawned() = 0;
+
+	virtual void Destroy(size_t slot) = 0;
+};
+
+// Storage for game objects of single type, which are placed into
+// fixed size chunks; objects never move, and freed slots are reused
+template<class T>
+class ObjectPool : public ObjectPoolBase {
+protected:
+	static const size_t chunk_size_ = 256;
+
+	enum SlotState : unsigned char {
+		FREE,
+		ACTIVE,
+		SPAWNED,
+	};
+
+	struct Chunk {
+		alignas(T) unsigned char storage[sizeof(T) * chunk_size_];
+		SlotState states[chunk_size_];
+
+		Chunk() {
+			std::fill(states, states + chunk_size_, FREE);
+		}
+
+		T* Get(size_t slot) {
+			return std::launder(reinterpret_cast<T*>(storage + slot * sizeof(T)));
+		}
+
+	};
+
+	typedef std::vector<std::unique_ptr<Chunk>> ChunkVector;
+	typedef std::vector<size_t> SlotVector; // chunk * chunk_size_ + slot
+
+protected:
+	ChunkVector chunks_;
+	SlotVector free_slots_;
+	SlotVector spawned_slots_;
+
+public:
+	ObjectPool() {
+	}
+
+	ObjectPool(const ObjectPool&) = delete;
+	ObjectPool& operator=(const ObjectPool&) = delete;
+
+	virtual ~ObjectPool() {
+		for (auto& chunk : chunks_)
+			for (size_t slot = 0; slot < chunk_size_; slot++)
+				if (chunk->states[slot] != FREE)
+					chunk->Get(slot)->~T();
+	}
+
+	template<class... Args>
+	T* Create(bool spawned, Args&&... args) {
+		if (free_slots_.empty()) {
+			chunks_.emplace_back(new Chunk);
+
+			// lower slots are used first
+			for (size_t slot = chunk_size_; slot > 0; slot--)
+				free_slots_.push_back((chunks_.size() - 1) * chunk_size_ + slot - 1);
+		}
+
+		size_t index = free_slots_.back();
+		Chunk& chunk = *chunks_[index / chunk_size_];
+		size_t slot = index % chunk_size_;
+
+		T* object = new (chunk.storage + slot * sizeof(T)) T(std::forward<Args>(args)...);
+		object->pool_ = this;
+		object->pool_slot_ = index;
+
+		free_slots_.pop_back();
+		if (spawned) {
+			chunk.states[slot] = SPAWNED;
+			spawned_slots_.push_back(index);
+		} else {
+			chunk.states[slot] = ACTIVE;
+		}
+
+		return object;
+	}
+
+	// first existing object, if any
+	T* GetFirst() {
+		for (auto& chunk : chunks_)
+			for (size_t slot = 0; slot < chunk_size_; slot++)
+				if (chunk->states[slot] != FREE)
+					return chunk->Get(slot);
+		return nullptr;
+	}
+
+	virtual size_t GetNumChunks() const {
+		return chunks_.size();
+	}
+
+	virtual void UpdateChunk(size_t nchunk, unsigned int deltams) {
+		Chunk& chunk = *chunks_[nchunk];
+		for (size_t slot = 0; slot < chunk_size_; slot++)
+			if (chunk.states[slot] == ACTIVE)
+				chunk.Get(slot)->Update(deltams);
+	}
+
+	virtual void Accept(Visitor& visitor) {
+		for (size_t nchunk = 0; nchunk < chunks_.size(); nchunk++) {
+			Chunk& chunk = *chunks_[nchunk];
+			for (size_t slot = 0; slot < chunk_size_; slot++)
+				if (chunk.states[slot] != FREE)
+					chunk.Get(slot)->Accept(visitor);
+		}
+	}
+
+	virtual void ActivateSpawned() {
+		for (auto& index : spawned_slots_) {
+			SlotState& state = chunks_[index / chunk_size_]->states[index % chunk_size_];
+			if (state == SPAWNED)
+				state = ACTIVE;
+		}
+		spawned_slots_.clear();
+	}
+
+	virtual void Destroy(size_t index) {
+		Chunk& chunk = *chunks_[index / chunk_size_];
+		size_t slot = index % chunk_size_;
+
+		chunk.Get(slot)->~T();
+		chunk.states[slot] = FREE;
+		free_slots_.push_back(index);
+	}
+};
+
+#endif // OBJECTPOOL_HH
@@ -35,7 +35,7 @@ public:
 	virtual void Visit(Building& obj) { Visit((GameObject&)obj); }
 	virtual void Visit(Explosion& obj) { Visit((GameObject&)obj); }
 	virtual void Visit(Heli& obj) { Visit((GameObject&)obj); }
-	virtual void Visit(Projectile& obj) { Visit((GameObject&)obj); }
+	virtual void Visit(Projectile&) {} // not a GameObject, see ProjectileSystem
 	virtual void Visit(Unit& obj) { Visit((GameObject&)obj); }
 };
 
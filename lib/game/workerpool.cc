@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <game/workerpool.hh>
+
+WorkerPool::WorkerPool(size_t num_threads) : job_(nullptr), num_items_(0), next_item_(0), generation_(0), active_workers_(0), stop_(false), notify_items_(false), finished_items_(0) {
+	try {
+		for (size_t i = 0; i < num_threads; i++)
+			threads_.emplace_back(&WorkerPool::WorkerThread, this);
+	} catch (...) {
+		Stop();
+		throw;
+	}
+}
+
+WorkerPool::~WorkerPool() {
+	Stop();
+}
+
+void WorkerPool::Stop() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stop_ = true;
+	}
+	start_cv_.notify_all();
+
+	for (auto& thread : threads_)
+		thread.join();
+	threads_.clear();
+}
+
+void WorkerPool::ProcessItems() {
+	size_t item;
+	while ((item = next_item_++) < num_items_) {
+		try {
+			(*job_)(item);
+		} catch (...) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			if (!error_)
+				error_ = std::current_exception();
+			next_item_ = num_items_;
+		}
+
+		if (notify_items_) {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				finished_items_++;
+			}
+			done_cv_.notify_one();
+		}
+	}
+}
+
+void WorkerPool::WorkerThread() {
+	unsigned long seen_generation = 0;
+
+	std::unique_lock<std::mutex> lock(mutex_);
+	while (1) {
+		start_cv_.wait(lock, [this, &seen_generation]() { return stop_ || generation_ != seen_generation; });
+		if (stop_)
+			return;
+
+		seen_generation = generation_;
+
+		lock.unlock();
+		ProcessItems();
+		lock.lock();
+
+		if (--active_workers_ == 0)
+			done_cv_.notify_one();
+	}
+}
+
+void WorkerPool::Start(size_t num_items, const Job& job, bool notify_items) {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		job_ = &job;
+		num_items_ = num_items;
+		next_item_ = 0;
+		active_workers_ = threads_.size();
+		notify_items_ = notify_items;
+		finished_items_ = 0;
+		generation_++;
+	}
+	start_cv_.notify_all();
+}
+
+void WorkerPool::Wait(const ProgressCallback* progress) {
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	size_t reported_items = 0;
+	while (1) {
+		done_cv_.wait(lock, [this, &reported_items]() { return active_workers_ == 0 || finished_items_ != reported_items; });
+
+		if (progress && finished_items_ != reported_items) {
+			reported_items = finished_items_;
+
+			lock.unlock();
+			try {
+				(*progress)();
+			} catch (...) {
+				// job may refer to caller's data, so wait for it anyway
+				next_item_ = num_items_;
+				lock.lock();
+				done_cv_.wait(lock, [this]() { return active_workers_ == 0; });
+				job_ = nullptr;
+				error_ = nullptr;
+				throw;
+			}
+			lock.lock();
+		} else if (active_workers_ == 0) {
+			break;
+		}
+	}
+
+	job_ = nullptr;
+
+	if (error_) {
+		std::exception_ptr error = error_;
+		error_ = nullptr;
+		std::rethrow_exception(error);
+	}
+}
+
+void WorkerPool::Run(size_t num_items, const Job& job) {
+	if (threads_.empty() || num_items <= 1) {
+		for (size_t item = 0; item < num_items; item++)
+			job(item);
+		return;
+	}
+
+	Start(num_items, job, false);
+	ProcessItems();
+	Wait(nullptr);
+}
+
+void WorkerPool::Run(size_t num_items, const Job& job, const ProgressCallback& progress) {
+	if (threads_.empty()) {
+		for (size_t item = 0; item < num_items; item++) {
+			job(item);
+			progress();
+		}
+		return;
+	}
+
+	Start(num_items, job, true);
+	Wait(&progress);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WORKERPOOL_HH
+#define WORKERPOOL_HH
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+// Persistent set of threads which process numbered work items;
+// idle threads take next unprocessed item, so uneven items
+// are balanced between threads
+class WorkerPool {
+public:
+	typedef std::function<void(size_t)> Job;
+	typedef std::function<void()> ProgressCallback;
+
+protected:
+	std::vector<std::thread> threads_;
+
+	std::mutex mutex_;
+	std::condition_variable start_cv_;
+	std::condition_variable done_cv_;
+
+	const Job* job_;
+	size_t num_items_;
+	std::atomic<size_t> next_item_;
+
+	unsigned long generation_;
+	size_t active_workers_;
+	bool stop_;
+
+	bool notify_items_;
+	size_t finished_items_;
+
+	std::exception_ptr error_;
+
+protected:
+	void Stop();
+	void ProcessItems();
+	void WorkerThread();
+
+	void Start(size_t num_items, const Job& job, bool notify_items);
+	void Wait(const ProgressCallback* progress);
+
+public:
+	// num_threads is number of additional threads, as
+	// calling thread takes part in processing as well
+	WorkerPool(size_t num_threads);
+	~WorkerPool();
+
+	WorkerPool(const WorkerPool&) = delete;
+	WorkerPool& operator=(const WorkerPool&) = delete;
+
+	// calls job(0) .. job(num_items - 1) and waits for completion;
+	// first exception thrown by job is rethrown
+	void Run(size_t num_items, const Job& job);
+
+	// same, but calling thread does not take part in processing;
+	// instead, it calls progress each time some items are finished
+	void Run(size_t num_items, const Job& job, const ProgressCallback& progress);
+
+};
+
+#endif // WORKERPOOL_HH
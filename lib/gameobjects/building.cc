@@ -17,9 +17,10 @@
  * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <game/visitor.hh>
-#include <game/game.hh>
+#include <limits>
+#include <algorithm>
 
+#include <game/visitor.hh>
 #include <game/game.hh>
 
 #include <gameobjects/explosion.hh>
@@ -33,6 +34,8 @@ Building::Building(Game& game, const Vector3f& pos, int health, unsigned short t
 	  sprite_offset_(sprite_offset),
 	  dead_type_(type),
 	  dead_sprite_offset_(sprite_offset),
+	  extents_min_(std::numeric_limits<float>::max(), std::numeric_limits<float>::max()),
+	  extents_max_(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()),
 	  health_(health) {
 }
 
@@ -43,6 +46,8 @@ Building::Building(Game& game, const Vector3f& pos, int health, unsigned short t
 	  sprite_offset_(sprite_offset),
 	  dead_type_(dead_type),
 	  dead_sprite_offset_(dead_sprite_offset),
+	  extents_min_(std::numeric_limits<float>::max(), std::numeric_limits<float>::max()),
+	  extents_max_(std::numeric_limits<float>::lowest(), std::numeric_limits<float>::lowest()),
 	  health_(health) {
 }
 
@@ -69,3 +74,27 @@ void Building::Die() {
 	sprite_offset_ = dead_sprite_offset_;
 	bboxes_.swap(dead_bboxes_);
 }
+
+void Building::AddBBox(const BBoxf& bbox) {
+	bboxes_.emplace_back(bbox);
+	AddExtents(bbox);
+}
+
+void Building::AddDeadBBox(const BBoxf& bbox) {
+	dead_bboxes_.emplace_back(bbox);
+	AddExtents(bbox);
+}
+
+void Building::AddExtents(const BBoxf& bbox) {
+	BBoxf placed = bbox;
+	placed.pos = pos_;
+
+	placed.ForEachEdge([this](const Vector3f& a, const Vector3f& b) {
+		for (const Vector3f& point : { a, b }) {
+			extents_min_ = Vector2f(std::min(extents_min_.x, point.x), std::min(extents_min_.y, point.y));
+			extents_max_ = Vector2f(std::max(extents_max_.x, point.x), std::max(extents_max_.y, point.y));
+		}
+	});
+
+	game_.AddToGrid(this, extents_min_, extents_max_);
+}
@@ -43,8 +43,15 @@ protected:
 	std::vector<BBoxf> bboxes_;
 	std::vector<BBoxf> dead_bboxes_;
 
+	// ground extents of all bboxes, alive and dead
+	Vector2f extents_min_;
+	Vector2f extents_max_;
+
 	int health_;
 
+protected:
+	void AddExtents(const BBoxf& bbox);
+
 public:
 	Building(Game& game, const Vector3f& pos, int health, unsigned short type, const Vector3f& sprite_offset);
 	Building(Game& game, const Vector3f& pos, int health, unsigned short type, const Vector3f& sprite_offset, unsigned short dead_type, const Vector3f& dead_sprite_offset);
@@ -67,13 +74,8 @@ public:
 		return type_;
 	}
 
-	void AddBBox(const BBoxf& bbox) {
-		bboxes_.emplace_back(bbox);
-	}
-
-	void AddDeadBBox(const BBoxf& bbox) {
-		dead_bboxes_.emplace_back(bbox);
-	}
+	void AddBBox(const BBoxf& bbox);
+	void AddDeadBBox(const BBoxf& bbox);
 
 	void ForeachBBox(const std::function<void(const BBoxf&)> bbox_processor) const {
 		for (auto bbox : bboxes_) {
@@ -18,20 +18,22 @@
  */
 
 #include <cmath>
-#include <cstdlib>
+#include <bit>
+#include <cstdint>
 
 #include <game/game.hh>
 #include <game/visitor.hh>
 
-#include <gameobjects/projectile.hh>
+#include <gameobjects/projectilesystem.hh>
 
 #include <gameobjects/heli.hh>
 
-Heli::Heli(Game& game, const Vector2f& pos) : GameObject(game) {
+Heli::Heli(Game& game, const Vector2f& pos) : GameObject(game), rng_(std::bit_cast<uint32_t>(pos.x) * 31 + std::bit_cast<uint32_t>(pos.y)) {
 	age_ = 0;
 
 	pos_ = pos;
 	pos_.z = Constants::MaxHeight();
+	prev_pos_ = pos_;
 
 	guns_ = Constants::GunCapacity();
 	hydras_ = Constants::HydraCapacity();;
@@ -54,6 +56,8 @@ void Heli::Accept(Visitor& visitor) {
 }
 
 void Heli::Update(unsigned int deltams) {
+	prev_pos_ = pos_;
+
 	UpdatePhysics(deltams);
 	UpdateWeapons(deltams);
 
@@ -102,9 +106,11 @@ void Heli::UpdateWeapons(unsigned int deltams) {
 
 	// Process gunfire
 	if (combined_control_flags & GUN && guns_ > 0 && gun_reload_ <= 0) {
-		float yawdispersion = (2.0 * std::rand() / RAND_MAX - 1.0) * Constants::GunDispersion();
-		float pitchdispersion = (2.0 * std::rand() / RAND_MAX - 1.0) * Constants::GunDispersion();
-		game_.Spawn<Projectile>(
+		std::uniform_real_distribution<float> dispersion(-Constants::GunDispersion(), Constants::GunDispersion());
+		float yawdispersion = dispersion(rng_);
+		float pitchdispersion = dispersion(rng_);
+		ProjectileSystem::SpawnLater(
+				game_,
 				pos_ + Constants::GunOffset() * GetSectorDirection(),
 				vel_,
 				Direction3f(GetSectorDirection().yaw + yawdispersion, Constants::WeaponFirePitch() + pitchdispersion),
@@ -120,7 +126,8 @@ void Heli::UpdateWeapons(unsigned int deltams) {
 		if (hydra_at_left_)
 			mount_offset.x = -mount_offset.x;
 
-		game_.Spawn<Projectile>(
+		ProjectileSystem::SpawnLater(
+				game_,
 				pos_ + mount_offset * GetSectorDirection(),
 				vel_,
 				Direction3f(GetSectorDirection(), Constants::WeaponFirePitch()),
@@ -137,7 +144,8 @@ void Heli::UpdateWeapons(unsigned int deltams) {
 		if (hellfire_at_left_)
 			mount_offset.x = -mount_offset.x;
 
-		game_.Spawn<Projectile>(
+		ProjectileSystem::SpawnLater(
+				game_,
 				pos_ + mount_offset * GetSectorDirection(),
 				vel_,
 				Direction3f(GetSectorDirection(), Constants::WeaponFirePitch()),
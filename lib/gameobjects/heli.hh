@@ -20,6 +20,8 @@
 #ifndef HELI_HH
 #define HELI_HH
 
+#include <random>
+
 #include <math/pi.hh>
 #include <math/geom.hh>
 
@@ -92,6 +94,7 @@ protected:
 	Direction2f direction_;
 
 	Vector3f pos_;
+	Vector3f prev_pos_; // before last update
 	Vector3f vel_;
 
 	// payload
@@ -110,6 +113,10 @@ protected:
 	int hydra_at_left_;
 	int hellfire_at_left_;
 
+	// gun dispersion; own for each heli, as objects are
+	// updated from multiple threads
+	std::minstd_rand rng_;
+
 	// control
 	int control_flags_;
 	int tick_control_flags_;
@@ -139,6 +146,11 @@ public:
 		return pos_;
 	}
 
+	// position between previous and current update
+	Vector3f GetInterpolatedPos(float interpolation) const {
+		return prev_pos_ + (pos_ - prev_pos_) * interpolation;
+	}
+
 	void AddControlFlags(int flags) {
 		control_flags_ |= flags;
 		tick_control_flags_ |= flags;
@@ -20,14 +20,15 @@
 #ifndef PROJECTILE_HH
 #define PROJECTILE_HH
 
-#include <math/geom.hh>
+#include <cstddef>
 
-#include <game/gameobject.hh>
+#include <math/geom.hh>
 
-class Game;
-class Visitor;
+class ProjectileSystem;
 
-class Projectile : public GameObject {
+// Single projectile stored in ProjectileSystem, as seen by visitors;
+// only valid until the next update of the system
+class Projectile {
 public:
 	enum Type {
 		BULLET,
@@ -36,34 +37,20 @@ public:
 	};
 
 protected:
-	struct Constants {
-		static constexpr float Speed() { return 400.0; } // XXX: make this variable, e.g. if enemy bullets may be faster/slower
-		static constexpr float GForce() { return 100.0; } // XXX: does if affect enemy bullets?
-	};
-
-protected:
-	Vector3f pos_;
-	Vector3f vel_;
-	Direction3f dir_;
-	Type type_;
+	const ProjectileSystem* system_;
+	size_t index_;
 
 public:
-	Projectile(Game& game, const Vector3f& pos, const Vector3f& vel, const Direction3f& direction, Type type);
-
-	virtual void Accept(Visitor& visitor);
-	virtual void Update(unsigned int deltams);
+	Projectile();
+	Projectile(const ProjectileSystem& system, size_t index);
 
-	Vector3f GetPos() const {
-		return pos_;
-	}
+	Vector3f GetPos() const;
 
-	Direction3f GetDirection() const {
-		return dir_;
-	}
+	// position between previous and current update
+	Vector3f GetInterpolatedPos(float interpolation) const;
 
-	Type GetType() const {
-		return type_;
-	}
+	Direction3f GetDirection() const;
+	Type GetType() const;
 };
 
 #endif // PROJECTILE_HH
@@ -0,0 +1,231 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <game/visitor.hh>
+#include <game/game.hh>
+
+#include <gameobjects/explosion.hh>
+#include <gameobjects/building.hh>
+
+#include <gameobjects/projectilesystem.hh>
+
+// finds the first building on the segment
+class FirstHitVisitor : public Visitor {
+protected:
+	Vector3f from_;
+	Vector3f to_;
+	Building* building_;
+	float time_;
+
+public:
+	FirstHitVisitor() : building_(nullptr), time_(1.0f) {
+	}
+
+	void Reset(const Vector3f& from, const Vector3f& to) {
+		from_ = from;
+		to_ = to;
+		building_ = nullptr;
+		time_ = 1.0f;
+	}
+
+	void Visit(Building& building) {
+		building.ForeachBBox([this, &building](const BBoxf& bbox) {
+			float time;
+			if (bbox.IntersectSegment(from_, to_, time) && time <= time_) {
+				building_ = &building;
+				time_ = time;
+			}
+		});
+	}
+
+	Building* GetBuilding() const {
+		return building_;
+	}
+
+	float GetTime() const {
+		return time_;
+	}
+};
+
+ProjectileSystem::ProjectileSystem(Game& game) : GameObject(game) {
+}
+
+void ProjectileSystem::SpawnLater(Game& game, const Vector3f& pos, const Vector3f& vel, const Direction3f& direction, Projectile::Type type) {
+	Game* gameptr = &game;
+	game.Defer([gameptr, pos, vel, direction, type]() {
+		gameptr->GetSingleton<ProjectileSystem>().Add(pos, vel, direction, type);
+	});
+}
+
+void ProjectileSystem::Add(const Vector3f& pos, const Vector3f& vel, const Direction3f& direction, Projectile::Type type) {
+	Vector3f initial_vel = vel + direction * Constants::Speed();
+
+	x_.push_back(pos.x);
+	y_.push_back(pos.y);
+	z_.push_back(pos.z);
+	vx_.push_back(initial_vel.x);
+	vy_.push_back(initial_vel.y);
+	vz_.push_back(initial_vel.z);
+	gforce_.push_back(type == Projectile::BULLET ? Constants::GForce() : 0.0f);
+	prev_x_.push_back(pos.x);
+	prev_y_.push_back(pos.y);
+	prev_z_.push_back(pos.z);
+	directions_.push_back(direction);
+	types_.push_back(type);
+}
+
+size_t ProjectileSystem::GetNumProjectiles() const {
+	return x_.size();
+}
+
+void ProjectileSystem::Accept(Visitor& visitor) {
+	for (size_t i = 0; i < x_.size(); i++) {
+		Projectile projectile(*this, i);
+		visitor.Visit(projectile);
+	}
+}
+
+void ProjectileSystem::Hit(size_t index, const Vector3f& pos, bool ground) {
+	dead_[index] = 1;
+
+	switch (types_[index]) {
+	case Projectile::BULLET:   game_.SpawnLater<Explosion>(pos, ground ? Explosion::GUN_GROUND : Explosion::GUN_OBJECT); break;
+	case Projectile::HYDRA:    game_.SpawnLater<Explosion>(pos, Explosion::HYDRA); break;
+	case Projectile::HELLFIRE: game_.SpawnLater<Explosion>(pos, Explosion::HELLFIRE); break;
+	}
+}
+
+void ProjectileSystem::RemoveDead() {
+	// order of projectiles is not significant, so the last one
+	// is moved into each freed place
+	size_t count = x_.size();
+	for (size_t i = 0; i < count; ) {
+		if (!dead_[i]) {
+			i++;
+			continue;
+		}
+
+		count--;
+		x_[i] = x_[count];
+		y_[i] = y_[count];
+		z_[i] = z_[count];
+		vx_[i] = vx_[count];
+		vy_[i] = vy_[count];
+		vz_[i] = vz_[count];
+		gforce_[i] = gforce_[count];
+		prev_x_[i] = prev_x_[count];
+		prev_y_[i] = prev_y_[count];
+		prev_z_[i] = prev_z_[count];
+		directions_[i] = directions_[count];
+		types_[i] = types_[count];
+		dead_[i] = dead_[count];
+	}
+
+	x_.resize(count);
+	y_.resize(count);
+	z_.resize(count);
+	vx_.resize(count);
+	vy_.resize(count);
+	vz_.resize(count);
+	gforce_.resize(count);
+	prev_x_.resize(count);
+	prev_y_.resize(count);
+	prev_z_.resize(count);
+	directions_.resize(count);
+	types_.resize(count);
+}
+
+void ProjectileSystem::Update(unsigned int deltams) {
+	const float delta_sec = deltams / 1000.0f;
+	const size_t count = x_.size();
+
+	hit_ground_.resize(count);
+	dead_.assign(count, 0);
+
+	float* x = x_.data();
+	float* y = y_.data();
+	float* z = z_.data();
+	const float* vx = vx_.data();
+	const float* vy = vy_.data();
+	float* vz = vz_.data();
+	float* prev_x = prev_x_.data();
+	float* prev_y = prev_y_.data();
+	float* prev_z = prev_z_.data();
+	unsigned char* hit_ground = hit_ground_.data();
+
+	// XXX: bullet actually moves along a parabola, should take into account
+	// rockets, otoh, move  along a straight line
+	for (size_t i = 0; i < count; i++) {
+		prev_x[i] = x[i];
+		prev_y[i] = y[i];
+		prev_z[i] = z[i];
+		x[i] += vx[i] * delta_sec;
+		y[i] += vy[i] * delta_sec;
+		z[i] += vz[i] * delta_sec;
+		hit_ground[i] = z[i] <= 0.0f;
+	}
+
+	// collisions with buildings are rare and need the grid, so they
+	// are checked per projectile
+	FirstHitVisitor hit_visitor;
+	for (size_t i = 0; i < count; i++) {
+		Vector3f from(prev_x[i], prev_y[i], prev_z[i]);
+		Vector3f to(x[i], y[i], z[i]);
+
+		hit_visitor.Reset(from, to);
+		game_.AcceptInArea(hit_visitor,
+				Vector2f(std::min(from.x, to.x), std::min(from.y, to.y)),
+				Vector2f(std::max(from.x, to.x), std::max(from.y, to.y))
+			);
+
+		// object hit, unless the ground was hit earlier
+		Building* hit_building = hit_visitor.GetBuilding();
+		if (hit_building != nullptr && (!hit_ground[i] || from.z <= 0 || hit_visitor.GetTime() <= from.z / (from.z - to.z))) {
+			int damage = 0;
+			switch (types_[i]) {
+			case Projectile::BULLET:   damage = 3; break;
+			case Projectile::HYDRA:    damage = 25; break;
+			case Projectile::HELLFIRE: damage = 100; break;
+			}
+
+			game_.Defer([hit_building, damage]() {
+				hit_building->Damage(damage);
+			});
+
+			Hit(i, from + (to - from) * hit_visitor.GetTime(), false);
+		} else if (hit_ground[i]) {
+			// calculate exact collision point
+			Vector3f vel(vx[i], vy[i], vz[i]);
+			float penetration = to.z / vel.z;
+
+			Hit(i, to - vel * delta_sec * penetration, true);
+		}
+	}
+
+	// g-force effect
+	const float* gforce = gforce_.data();
+	for (size_t i = 0; i < count; i++)
+		vz[i] -= gforce[i] * delta_sec;
+
+	RemoveDead();
+
+	// XXX: limit lifetime if it doesn't hit the ground
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PROJECTILESYSTEM_HH
+#define PROJECTILESYSTEM_HH
+
+#include <vector>
+
+#include <math/geom.hh>
+
+#include <game/gameobject.hh>
+
+#include <gameobjects/projectile.hh>
+
+class Game;
+class Visitor;
+
+// All live projectiles, kept as structure of arrays so that motion
+// and ground hits are processed in tight loops over plain floats
+class ProjectileSystem : public GameObject {
+	friend class Projectile;
+
+protected:
+	struct Constants {
+		static constexpr float Speed() { return 400.0; } // XXX: make this variable, e.g. if enemy bullets may be faster/slower
+		static constexpr float GForce() { return 100.0; } // XXX: does if affect enemy bullets?
+	};
+
+protected:
+	std::vector<float> x_;
+	std::vector<float> y_;
+	std::vector<float> z_;
+	std::vector<float> vx_;
+	std::vector<float> vy_;
+	std::vector<float> vz_;
+	std::vector<float> gforce_; // nonzero for bullets only
+
+	// position before last update
+	std::vector<float> prev_x_;
+	std::vector<float> prev_y_;
+	std::vector<float> prev_z_;
+
+	std::vector<Direction3f> directions_;
+	std::vector<Projectile::Type> types_;
+
+	// per-update scratch
+	std::vector<unsigned char> hit_ground_;
+	std::vector<unsigned char> dead_;
+
+protected:
+	// removes projectile after update, leaving explosion at pos
+	void Hit(size_t index, const Vector3f& pos, bool ground);
+	void RemoveDead();
+
+public:
+	ProjectileSystem(Game& game);
+
+	// the system is updated in parallel with other objects, so
+	// from GameObject::Update() projectiles are added through this
+	static void SpawnLater(Game& game, const Vector3f& pos, const Vector3f& vel, const Direction3f& direction, Projectile::Type type);
+
+	void Add(const Vector3f& pos, const Vector3f& vel, const Direction3f& direction, Projectile::Type type);
+
+	size_t GetNumProjectiles() const;
+
+	// visits each projectile
+	virtual void Accept(Visitor& visitor);
+	virtual void Update(unsigned int deltams);
+};
+
+#endif // PROJECTILESYSTEM_HH
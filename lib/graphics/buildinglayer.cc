@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include <game/game.hh>
+#include <game/visitor.hh>
+#include <graphics/camera.hh>
+
+#include <gameobjects/building.hh>
+
+#include <graphics/buildinglayer.hh>
+
+const int BuildingLayer::tile_size_ = 256;
+const size_t BuildingLayer::max_cached_tiles_ = 64;
+
+BuildingLayer::BuildingLayer(SDL2pp::Renderer& renderer, BlockMapMap& block_maps)
+	: renderer_(renderer),
+	  block_maps_(block_maps),
+	  game_generation_(0),
+	  num_textures_(0),
+	  frame_(0) {
+}
+
+SDL2pp::Point BuildingLayer::GetLayerPos(const Vector3f& point) {
+	// same as Camera::GameToScreen() without camera offset
+	return SDL2pp::Point(
+			(int)std::round(point.x),
+			(int)std::round(point.y / 2) - (int)std::round(point.z)
+		);
+}
+
+int BuildingLayer::GetTileIndex(int coord) {
+	return coord >= 0 ? coord / tile_size_ : -((-coord - 1) / tile_size_) - 1;
+}
+
+SDL2pp::Rect BuildingLayer::GetBuildingRect(const Building& building) const {
+	auto blockmap = block_maps_.find(building.GetType());
+	assert(blockmap != block_maps_.end());
+
+	SDL2pp::Point pos = GetLayerPos(building.GetPos() + building.GetSpriteOffset());
+	return SDL2pp::Rect(pos.GetX(), pos.GetY(), blockmap->second.GetWidth(), blockmap->second.GetHeight());
+}
+
+void BuildingLayer::Reset(Game& game) {
+	class BuildingCollector : public Visitor {
+	public:
+		std::vector<Building*> buildings;
+
+		virtual void Visit(Building& building) {
+			buildings.push_back(&building);
+		}
+	};
+
+	BuildingCollector collector;
+	game.Accept(collector);
+
+	// same order as ObjectSorter would give
+	std::stable_sort(collector.buildings.begin(), collector.buildings.end(), [](const Building* a, const Building* b) {
+		return a->GetPos().z + a->GetPos().y / 2 < b->GetPos().z + b->GetPos().y / 2;
+	});
+
+	game_generation_ = game.GetGeneration();
+	buildings_.clear();
+	tiles_.clear();
+	num_textures_ = 0;
+
+	for (auto& building : collector.buildings) {
+		buildings_.push_back(BakedBuilding{building, building->GetType(), GetBuildingRect(*building)});
+		AddToTiles(buildings_.size() - 1);
+	}
+}
+
+void BuildingLayer::AddToTiles(size_t nbuilding) {
+	const SDL2pp::Rect& rect = buildings_[nbuilding].rect;
+
+	for (int y = GetTileIndex(rect.GetY()); y <= GetTileIndex(rect.GetY2()); y++) {
+		for (int x = GetTileIndex(rect.GetX()); x <= GetTileIndex(rect.GetX2()); x++) {
+			Tile& tile = tiles_[TileCoords(x, y)];
+
+			auto place = std::lower_bound(tile.buildings.begin(), tile.buildings.end(), nbuilding);
+			if (place == tile.buildings.end() || *place != nbuilding)
+				tile.buildings.insert(place, nbuilding);
+
+			tile.dirty = true;
+		}
+	}
+}
+
+void BuildingLayer::MarkDirty(const SDL2pp::Rect& rect) {
+	for (int y = GetTileIndex(rect.GetY()); y <= GetTileIndex(rect.GetY2()); y++) {
+		for (int x = GetTileIndex(rect.GetX()); x <= GetTileIndex(rect.GetX2()); x++) {
+			auto tile = tiles_.find(TileCoords(x, y));
+			if (tile != tiles_.end())
+				tile->second.dirty = true;
+		}
+	}
+}
+
+void BuildingLayer::Bake(const TileCoords& coords, Tile& tile) {
+	renderer_.SetTarget(*tile.texture);
+	renderer_.SetDrawColor(0, 0, 0, 0);
+	renderer_.Clear();
+
+	for (auto& nbuilding : tile.buildings) {
+		const BakedBuilding& building = buildings_[nbuilding];
+
+		auto blockmap = block_maps_.find(building.type);
+		assert(blockmap != block_maps_.end());
+
+		blockmap->second.Render(building.rect.GetX() - coords.first * tile_size_, building.rect.GetY() - coords.second * tile_size_);
+	}
+
+	renderer_.SetTarget();
+
+	tile.dirty = false;
+}
+
+void BuildingLayer::FreeUnusedTextures() {
+	if (num_textures_ <= max_cached_tiles_)
+		return;
+
+	// least recently shown first
+	std::vector<Tile*> unused;
+	for (auto& tile : tiles_)
+		if (tile.second.texture && tile.second.last_used_frame != frame_)
+			unused.push_back(&tile.second);
+
+	std::sort(unused.begin(), unused.end(), [](const Tile* a, const Tile* b) {
+		return a->last_used_frame < b->last_used_frame;
+	});
+
+	for (auto& tile : unused) {
+		if (num_textures_ <= max_cached_tiles_)
+			break;
+		tile->texture.reset();
+		num_textures_--;
+	}
+}
+
+void BuildingLayer::Render(Game& game, const Camera& camera) {
+	// new level may be moved into the same game object
+	if (game.GetGeneration() != game_generation_)
+		Reset(game);
+
+	// buildings which changed their look since they were baked
+	for (size_t nbuilding = 0; nbuilding < buildings_.size(); nbuilding++) {
+		BakedBuilding& building = buildings_[nbuilding];
+		if (building.building->GetType() != building.type) {
+			MarkDirty(building.rect);
+			building.type = building.building->GetType();
+			building.rect = GetBuildingRect(*building.building);
+			AddToTiles(nbuilding);
+		}
+	}
+
+	SDL2pp::Point origin = camera.GameToScreen(Vector3f(0, 0, 0));
+	SDL2pp::Rect viewport = camera.GetViewport();
+
+	for (int y = GetTileIndex(viewport.GetY() - origin.GetY()); y <= GetTileIndex(viewport.GetY2() - origin.GetY()); y++) {
+		for (int x = GetTileIndex(viewport.GetX() - origin.GetX()); x <= GetTileIndex(viewport.GetX2() - origin.GetX()); x++) {
+			auto tile = tiles_.find(TileCoords(x, y));
+			if (tile == tiles_.end())
+				continue;
+
+			if (!tile->second.texture) {
+				tile->second.texture.reset(new SDL2pp::Texture(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET, tile_size_, tile_size_));
+				tile->second.texture->SetBlendMode(SDL_BLENDMODE_BLEND);
+				tile->second.dirty = true;
+				num_textures_++;
+			}
+
+			if (tile->second.dirty)
+				Bake(tile->first, tile->second);
+
+			renderer_.Copy(
+					*tile->second.texture,
+					SDL2pp::NullOpt,
+					SDL2pp::Rect(origin.GetX() + x * tile_size_, origin.GetY() + y * tile_size_, tile_size_, tile_size_)
+				);
+
+			tile->second.last_used_frame = frame_;
+		}
+	}
+
+	FreeUnusedTextures();
+	frame_++;
+}
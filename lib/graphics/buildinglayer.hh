@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BUILDINGLAYER_HH
+#define BUILDINGLAYER_HH
+
+#include <map>
+#include <memory>
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+#include <SDL2pp/Renderer.hh>
+#include <SDL2pp/Texture.hh>
+#include <SDL2pp/Rect.hh>
+#include <SDL2pp/Point.hh>
+
+#include <math/geom.hh>
+
+#include <graphics/spritemanager.hh>
+
+class Building;
+class Camera;
+class Game;
+
+// All buildings of the game, pre-rendered into large tiles so
+// they are drawn with a few texture copies per frame. Tiles are
+// baked when first shown and re-baked when any building within
+// changes its look (e.g. is destroyed). Buildings are expected to
+// live as long as the game.
+class BuildingLayer {
+public:
+	typedef std::map<unsigned short, SpriteManager::BlockMap> BlockMapMap;
+
+protected:
+	static const int tile_size_;
+	static const size_t max_cached_tiles_;
+
+	struct BakedBuilding {
+		Building* building;
+		unsigned short type;
+		SDL2pp::Rect rect; // in layer coordinates, see GetLayerPos()
+	};
+
+	struct Tile {
+		std::unique_ptr<SDL2pp::Texture> texture;
+		std::vector<size_t> buildings; // in drawing order
+		bool dirty;
+		unsigned int last_used_frame;
+
+		Tile() : dirty(true), last_used_frame(0) {
+		}
+	};
+
+	typedef std::pair<int, int> TileCoords;
+	typedef std::map<TileCoords, Tile> TileMap;
+
+protected:
+	SDL2pp::Renderer& renderer_;
+	BlockMapMap& block_maps_;
+
+	uint64_t game_generation_; // 0 if not built yet
+	std::vector<BakedBuilding> buildings_;
+	TileMap tiles_;
+	size_t num_textures_;
+	unsigned int frame_;
+
+protected:
+	static SDL2pp::Point GetLayerPos(const Vector3f& point);
+	static int GetTileIndex(int coord);
+
+	SDL2pp::Rect GetBuildingRect(const Building& building) const;
+
+	void Reset(Game& game);
+	void AddToTiles(size_t nbuilding);
+	void MarkDirty(const SDL2pp::Rect& rect);
+	void Bake(const TileCoords& coords, Tile& tile);
+	void FreeUnusedTextures();
+
+public:
+	BuildingLayer(SDL2pp::Renderer& renderer, BlockMapMap& block_maps);
+
+	void Render(Game& game, const Camera& camera);
+};
+
+#endif // BUILDINGLAYER_HH
@@ -46,3 +46,17 @@ SDL2pp::Point Camera::GameToScreen(const Vector3f& point) const {
 			viewport_.GetY() + viewport_.GetH() / 2 + (int)std::round(point.y / 2) - (int)std::round(target_.y / 2) - (int)std::round(point.z) + (int)std::round(target_.z)
 		);
 }
+
+Vector2f Camera::GetVisibleMin(int margin) const {
+	return Vector2f(
+			target_.x - viewport_.GetW() / 2 - margin,
+			target_.y - target_.z * 2 - viewport_.GetH() - margin * 2
+		);
+}
+
+Vector2f Camera::GetVisibleMax(int margin) const {
+	return Vector2f(
+			target_.x + viewport_.GetW() / 2 + margin,
+			target_.y - target_.z * 2 + viewport_.GetH() + margin * 2
+		);
+}
@@ -39,6 +39,12 @@ public:
 	SDL2pp::Rect GetViewport() const;
 
 	SDL2pp::Point GameToScreen(const Vector3f& point) const;
+
+	// ground area visible in the viewport extended by margin (in
+	// pixels) on each side; as the view is oblique, point (x, y, z)
+	// is drawn at the same place as ground point (x, y - 2z)
+	Vector2f GetVisibleMin(int margin = 0) const;
+	Vector2f GetVisibleMax(int margin = 0) const;
 };
 
 #endif // CAMERA_HH
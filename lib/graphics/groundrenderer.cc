@@ -17,6 +17,8 @@
  * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+
 #include <game/game.hh>
 #include <graphics/camera.hh>
 
@@ -26,11 +28,18 @@ GroundRenderer::GroundRenderer(SDL2pp::Renderer& renderer) : renderer_(renderer)
 }
 
 void GroundRenderer::Render(const Game& game, const Camera& camera) {
-	renderer_.SetDrawColor(158, 126, 61);
-	renderer_.FillRect( // XXX: intersect this with screen
-			camera.GameToScreen(Vector2f(0, 0)),
-			camera.GameToScreen(Vector2f(game.GetWidth(), game.GetHeight()))
-		);
+	SDL2pp::Point min = camera.GameToScreen(Vector2f(0, 0));
+	SDL2pp::Point max = camera.GameToScreen(Vector2f(game.GetWidth(), game.GetHeight()));
+	SDL2pp::Rect viewport = camera.GetViewport();
+
+	// only fill part of the map which is on screen
+	min = SDL2pp::Point(std::max(min.GetX(), viewport.GetX()), std::max(min.GetY(), viewport.GetY()));
+	max = SDL2pp::Point(std::min(max.GetX(), viewport.GetX2()), std::min(max.GetY(), viewport.GetY2()));
+
+	if (min.GetX() <= max.GetX() && min.GetY() <= max.GetY()) {
+		renderer_.SetDrawColor(158, 126, 61);
+		renderer_.FillRect(min, max);
+	}
 
 #if defined DEBUG_RENDERING
 	// Draw sector grid
@@ -22,14 +22,39 @@
 #include <gameobjects/heli.hh>
 #include <gameobjects/projectile.hh>
 
+#include <math/radixsort.hh>
+
 #include <graphics/objectsorter.hh>
 
-ObjectSorter::ObjectSorter() {
+ObjectSorter::ObjectSorter() : include_buildings_(true), culling_(false) {
+}
+
+bool ObjectSorter::IsVisible(const Vector3f& pos) const {
+	if (!culling_)
+		return true;
+
+	float ground_y = pos.y - pos.z * 2;
+	return pos.x >= visible_min_.x && pos.x <= visible_max_.x && ground_y >= visible_min_.y && ground_y <= visible_max_.y;
 }
 
-void ObjectSorter::AddSorted(const Vector3f& pos, GameObject& obj) {
+void ObjectSorter::AddSorted(const Vector3f& pos, GameObject* obj, const Projectile& projectile) {
 	float sortkey = pos.z + pos.y / 2;
-	sorted_objects_.insert(std::make_pair(sortkey, &obj));
+	sorted_objects_.push_back(SortedObject{FloatToSortKey(sortkey), obj, projectile});
+}
+
+void ObjectSorter::Clear() {
+	sorted_objects_.clear();
+	other_objects_.clear();
+}
+
+void ObjectSorter::SetIncludeBuildings(bool include) {
+	include_buildings_ = include;
+}
+
+void ObjectSorter::SetVisibleArea(const Vector2f& min, const Vector2f& max) {
+	culling_ = true;
+	visible_min_ = min;
+	visible_max_ = max;
 }
 
 void ObjectSorter::Visit(GameObject& obj) {
@@ -37,24 +62,45 @@ void ObjectSorter::Visit(GameObject& obj) {
 }
 
 void ObjectSorter::Visit(Building& building) {
-	AddSorted(building.GetPos(), building);
+	// sprite is placed by its top left corner
+	if (!include_buildings_ || !IsVisible(building.GetPos() + building.GetSpriteOffset()))
+		return;
+
+	AddSorted(building.GetPos(), &building);
 }
 
 void ObjectSorter::Visit(Explosion& explosion) {
-	AddSorted(explosion.GetPos(), explosion);
+	if (!IsVisible(explosion.GetPos()))
+		return;
+
+	AddSorted(explosion.GetPos(), &explosion);
 }
 
 void ObjectSorter::Visit(Heli& heli) {
-	AddSorted(heli.GetPos(), heli);
+	// shadow may be visible when heli itself is not
+	if (!IsVisible(heli.GetPos()) && !IsVisible(heli.GetPos().Grounded()))
+		return;
+
+	AddSorted(heli.GetPos(), &heli);
 }
 
 void ObjectSorter::Visit(Projectile& projectile) {
-	AddSorted(projectile.GetPos(), projectile);
+	if (!IsVisible(projectile.GetPos()))
+		return;
+
+	AddSorted(projectile.GetPos(), nullptr, projectile);
 }
 
 void ObjectSorter::Accept(Visitor& visitor) {
-	for (auto& object : sorted_objects_)
-		object.second->Accept(visitor);
+	// stable, so objects with equal keys are drawn in order of visiting
+	RadixSort(sorted_objects_, sort_scratch_, [](const SortedObject& object) { return object.sortkey; });
+
+	for (auto& object : sorted_objects_) {
+		if (object.object != nullptr)
+			object.object->Accept(visitor);
+		else
+			visitor.Visit(object.projectile);
+	}
 	for (auto& object : other_objects_)
 		object->Accept(visitor);
 }
@@ -20,24 +20,55 @@
 #ifndef OBJECTSORTER_HH
 #define OBJECTSORTER_HH
 
-#include <map>
 #include <vector>
+#include <cstdint>
 
 #include <math/geom.hh>
 
 #include <game/visitor.hh>
 
+#include <gameobjects/projectile.hh>
+
+// Collects objects in drawing order, skipping invisible ones;
+// keeps its storage, so it's meant to be reused between frames
 class ObjectSorter : public Visitor {
 protected:
-	std::multimap<float, GameObject*> sorted_objects_;
+	// projectiles are not game objects, so they're stored by value
+	struct SortedObject {
+		uint32_t sortkey;
+		GameObject* object;
+		Projectile projectile; // if object is null
+	};
+
+	typedef std::vector<SortedObject> SortedObjectVector;
+
+protected:
+	SortedObjectVector sorted_objects_;
+	SortedObjectVector sort_scratch_;
 	std::vector<GameObject*> other_objects_;
 
+	bool include_buildings_;
+	bool culling_;
+	Vector2f visible_min_;
+	Vector2f visible_max_;
+
 protected:
-	void AddSorted(const Vector3f& pos, GameObject& obj);
+	bool IsVisible(const Vector3f& pos) const;
+	void AddSorted(const Vector3f& pos, GameObject* obj, const Projectile& projectile = Projectile());
 
 public:
 	ObjectSorter();
 
+	// forget objects collected for previous frame
+	void Clear();
+
+	// buildings may be drawn separately, see BuildingLayer
+	void SetIncludeBuildings(bool include);
+
+	// ground area as returned by Camera::GetVisibleMin/Max(); objects
+	// drawn outside of it are skipped, except for unknown ones
+	void SetVisibleArea(const Vector2f& min, const Vector2f& max);
+
 	virtual void Visit(GameObject& obj);
 
 	virtual void Visit(Building& building);
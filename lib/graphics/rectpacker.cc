@@ -18,94 +18,208 @@
  */
 
 #include <stdexcept>
-#include <limits>
+#include <algorithm>
+#include <numeric>
 
 #include <graphics/rectpacker.hh>
 
-RectPacker::RectPacker(int pagewidth, int pageheight) : page_width_(pagewidth), page_height_(pageheight), num_pages_(0) {
+RectPacker::RectPacker(int pagewidth, int pageheight) : page_width_(pagewidth), page_height_(pageheight), num_width_classes_(GetWidthClass(pagewidth) + 1), free_tree_(2 * num_width_classes_, -1), free_tree_leaves_(1) {
 }
 
 RectPacker::~RectPacker() {
 }
 
-const RectPacker::Rect& RectPacker::Place(int width, int height, int padding) {
-	int alwidth = width + padding * 2;
-	int alheight = height + padding * 2;
+int RectPacker::GetWidthClass(int width) {
+	// largest n for which 1 << n <= width; 0 for empty rects
+	int width_class = 0;
+	while (width >> (width_class + 1))
+		width_class++;
+	return width_class;
+}
 
-	if (alwidth > page_width_ || alheight > page_height_)
-		throw std::logic_error("rect to large to fit into page");
+bool RectPacker::FindPosition(const Page& page, int width, int height, int& best_segment, int& best_y) const {
+	bool found = false;
+	int best_top = page_height_ + 1;
 
-	int area = alwidth * alheight;
+	for (size_t first = 0; first < page.skyline.size(); first++) {
+		int x = page.skyline[first].x;
+		if (x + width > page_width_)
+			break;
 
-	// Find rect with smallest wasted area
-	RectList::iterator best_rect = free_rects_.end();
-	int best_wasted_area = std::numeric_limits<int>::max();
-	for (RectList::iterator current_rect = free_rects_.begin(); current_rect != free_rects_.end(); ++current_rect) {
-		if (alwidth > current_rect->width || alheight > current_rect->height)
-			continue;
+		// rect is placed onto highest segment it spans
+		int y = 0;
+		for (size_t current = first; current < page.skyline.size() && page.skyline[current].x < x + width; current++) {
+			y = std::max(y, page.skyline[current].y);
+			if (y + height >= best_top)
+				break;
+		}
 
-		int wasted_area = current_rect->width * current_rect->height - area;
-		if (wasted_area < best_wasted_area) {
-			best_wasted_area = wasted_area;
-			best_rect = current_rect;
+		if (y + height < best_top) {
+			found = true;
+			best_top = y + height;
+			best_segment = first;
+			best_y = y;
 		}
 	}
 
-	// If not found, allocate new page
-	if (best_rect == free_rects_.end()) {
-		free_rects_.emplace_back(Rect(num_pages_++, 0, 0, page_width_, page_height_));
-		best_rect = --free_rects_.end();
+	return found && best_top <= page_height_;
+}
+
+void RectPacker::Occupy(Page& page, int nsegment, int y, int width, int height) {
+	std::vector<Segment>& skyline = page.skyline;
+	int x = skyline[nsegment].x;
+
+	// cut off parts of segments below new one
+	size_t next = nsegment;
+	while (next < skyline.size() && skyline[next].x + skyline[next].width <= x + width)
+		next++;
+	if (next < skyline.size() && skyline[next].x < x + width) {
+		skyline[next].width -= x + width - skyline[next].x;
+		skyline[next].x = x + width;
 	}
 
-	// Safely allocate two more rects: one free for split and one used for result
-	used_rects_.emplace_back();
-	try {
-		free_rects_.emplace_back();
-	} catch (...) {
-		used_rects_.pop_back();
-		throw;
+	skyline.erase(skyline.begin() + nsegment, skyline.begin() + next);
+	skyline.insert(skyline.begin() + nsegment, Segment{x, y + height, width});
+
+	// merge with neighbors of the same height
+	if (nsegment + 1 < (int)skyline.size() && skyline[nsegment + 1].y == skyline[nsegment].y) {
+		skyline[nsegment].width += skyline[nsegment + 1].width;
+		skyline.erase(skyline.begin() + nsegment + 1);
+	}
+	if (nsegment > 0 && skyline[nsegment - 1].y == skyline[nsegment].y) {
+		skyline[nsegment - 1].width += skyline[nsegment].width;
+		skyline.erase(skyline.begin() + nsegment);
 	}
 
-	used_rects_.back().page = best_rect->page;
-	used_rects_.back().x = best_rect->x + padding;
-	used_rects_.back().y = best_rect->y + padding;
-	used_rects_.back().width = width;
-	used_rects_.back().height = height;
-
-	// find split direction so resulting rectangle is more square
-	if (best_rect->width - width - padding * 2 < best_rect->height - height - padding * 2) {
-		// split into top/bottom
-		free_rects_.back() = Rect(
-				best_rect->page,
-				best_rect->x,
-				best_rect->y + alheight,
-				best_rect->width,
-				best_rect->height - alheight
-			);
-		*best_rect = Rect(
-				best_rect->page,
-				best_rect->x + alwidth,
-				best_rect->y,
-				best_rect->width - alwidth,
-				alheight
-			);
-	} else {
-		// split into left/right
-		free_rects_.back() = Rect(
-				best_rect->page,
-				best_rect->x + alwidth,
-				best_rect->y,
-				best_rect->width - alwidth,
-				best_rect->height
-			);
-		*best_rect = Rect(
-				best_rect->page,
-				best_rect->x,
-				best_rect->y + alheight,
-				alwidth,
-				best_rect->height - alheight
-			);
+	page.used_area += width * height;
+}
+
+void RectPacker::AddPage(Page&& page) {
+	pages_.emplace_back(std::move(page));
+
+	if (pages_.size() > free_tree_leaves_) {
+		// out of leaves; double the tree, keeping known free heights
+		std::vector<int> free_tree(free_tree_leaves_ * 4 * num_width_classes_, -1);
+		std::copy(free_tree_.begin() + free_tree_leaves_ * num_width_classes_, free_tree_.end(), free_tree.begin() + free_tree_leaves_ * 2 * num_width_classes_);
+		free_tree_.swap(free_tree);
+		free_tree_leaves_ *= 2;
+
+		for (size_t node = free_tree_leaves_ - 1; node > 0; node--)
+			UpdateFreeTreeNode(node);
+	}
+
+	for (int width_class = 0; width_class < num_width_classes_; width_class++)
+		UpdateFreeHeight(pages_.size() - 1, width_class);
+}
+
+void RectPacker::UpdateFreeHeight(size_t npage, int width_class) {
+	const std::vector<Segment>& skyline = pages_[npage].skyline;
+	int width = 1 << width_class;
+
+	// same positions as checked by FindPosition(), and same cutoff
+	int lowest = page_height_ + 1;
+	for (size_t first = 0; first < skyline.size() && skyline[first].x + width <= page_width_; first++) {
+		int x = skyline[first].x;
+		int y = 0;
+		for (size_t current = first; current < skyline.size() && skyline[current].x < x + width && y < lowest; current++)
+			y = std::max(y, skyline[current].y);
+
+		lowest = std::min(lowest, y);
 	}
 
-	return used_rects_.back();
+	size_t node = free_tree_leaves_ + npage;
+	free_tree_[node * num_width_classes_ + width_class] = page_height_ - lowest;
+	for (node /= 2; node > 0; node /= 2)
+		free_tree_[node * num_width_classes_ + width_class] = std::max(free_tree_[node * 2 * num_width_classes_ + width_class], free_tree_[(node * 2 + 1) * num_width_classes_ + width_class]);
+}
+
+void RectPacker::UpdateFreeTreeNode(size_t node) {
+	int* free_heights = &free_tree_[node * num_width_classes_];
+	const int* left = &free_tree_[node * 2 * num_width_classes_];
+	const int* right = left + num_width_classes_;
+	for (int width_class = 0; width_class < num_width_classes_; width_class++)
+		free_heights[width_class] = std::max(left[width_class], right[width_class]);
+}
+
+size_t RectPacker::FindPage(size_t start, int width_class, int height) const {
+	return FindPage(1, 0, free_tree_leaves_, start, width_class, height);
+}
+
+size_t RectPacker::FindPage(size_t node, size_t first, size_t last, size_t start, int width_class, int height) const {
+	// node covers pages [first, last)
+	if (last <= start || free_tree_[node * num_width_classes_ + width_class] < height)
+		return pages_.size();
+
+	if (last - first == 1)
+		return first;
+
+	size_t middle = (first + last) / 2;
+	size_t found = FindPage(node * 2, first, middle, start, width_class, height);
+	if (found != pages_.size())
+		return found;
+
+	return FindPage(node * 2 + 1, middle, last, start, width_class, height);
+}
+
+RectPacker::Rect RectPacker::Place(int width, int height, int padding) {
+	int alwidth = width + padding * 2;
+	int alheight = height + padding * 2;
+
+	if (alwidth > page_width_ || alheight > page_height_)
+		throw std::logic_error("rect to large to fit into page");
+
+	// only pages which may have enough free space are scanned;
+	// as skyline only rises, indexed free heights stay valid
+	// (if loose) after placement, and are only refreshed for
+	// a page which turns out not to have enough space
+	int width_class = GetWidthClass(alwidth);
+	int nsegment = 0, y = 0;
+	size_t npage = FindPage(0, width_class, alheight);
+	while (npage < pages_.size() && !FindPosition(pages_[npage], alwidth, alheight, nsegment, y)) {
+		UpdateFreeHeight(npage, width_class);
+		npage = FindPage(npage + 1, width_class, alheight);
+	}
+
+	// If not found, allocate new page
+	if (npage == pages_.size()) {
+		AddPage(Page{{Segment{0, 0, page_width_}}, 0});
+		nsegment = 0;
+		y = 0;
+	}
+
+	Rect result(npage, pages_[npage].skyline[nsegment].x + padding, y + padding, width, height);
+
+	Occupy(pages_[npage], nsegment, y, alwidth, alheight);
+
+	return result;
+}
+
+std::vector<RectPacker::Rect> RectPacker::Place(const std::vector<Size>& sizes, int padding) {
+	std::vector<size_t> order(sizes.size());
+	std::iota(order.begin(), order.end(), 0);
+
+	std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b) {
+		if (sizes[a].height != sizes[b].height)
+			return sizes[a].height > sizes[b].height;
+		return sizes[a].width > sizes[b].width;
+	});
+
+	std::vector<Rect> result(sizes.size());
+	for (auto& index : order)
+		result[index] = Place(sizes[index].width, sizes[index].height, padding);
+
+	return result;
+}
+
+void RectPacker::SkipPages(int count) {
+	for (int i = 0; i < count; i++)
+		AddPage(Page{{Segment{0, page_height_, page_width_}}, page_width_ * page_height_});
+}
+
+int RectPacker::GetNumPages() const {
+	return pages_.size();
+}
+
+float RectPacker::GetOccupancy(int page) const {
+	return (float)pages_[page].used_area / (float)(page_width_ * page_height_);
 }
@@ -20,8 +20,14 @@
 #ifndef RECTPACKER_HH
 #define RECTPACKER_HH
 
-#include <list>
+#include <vector>
+#include <cstddef>
 
+// Places rectangles onto fixed size pages; each page keeps a
+// skyline (upper edge of occupied space), and a rect is placed
+// where its top is lowest, leftmost first; pages are indexed by
+// free height available for rects of each power of two width, so
+// pages which can't take a rect are mostly not visited
 class RectPacker {
 public:
 	struct Rect {
@@ -38,23 +44,74 @@ public:
 		}
 	};
 
+	struct Size {
+		int width;
+		int height;
+
+		Size(int nwidth, int nheight) : width(nwidth), height(nheight) {
+		}
+	};
+
 private:
-	typedef std::list<Rect> RectList;
+	// columns [x, x + width) are occupied up to y
+	struct Segment {
+		int x;
+		int y;
+		int width;
+	};
+
+	struct Page {
+		std::vector<Segment> skyline;
+		int used_area;
+	};
 
 private:
 	const int page_width_;
 	const int page_height_;
 
-	int num_pages_;
+	std::vector<Page> pages_;
+
+	// max tree over pages; each node keeps num_width_classes_
+	// values, largest free height for rects 1 << class wide
+	// (-1 if none fits), which bounds it for wider rects of
+	// the same class; values may be larger than actual ones,
+	// see Place(); leaves start at free_tree_leaves_
+	const int num_width_classes_;
+	std::vector<int> free_tree_;
+	size_t free_tree_leaves_;
+
+private:
+	static int GetWidthClass(int width);
+
+	bool FindPosition(const Page& page, int width, int height, int& best_segment, int& best_y) const;
+	void Occupy(Page& page, int nsegment, int y, int width, int height);
 
-	RectList free_rects_;
-	RectList used_rects_;
+	void AddPage(Page&& page);
+	void UpdateFreeHeight(size_t npage, int width_class);
+	void UpdateFreeTreeNode(size_t node);
+
+	// first page not before start which may have place for
+	// rect of given width class and height; pages_.size() if none
+	size_t FindPage(size_t start, int width_class, int height) const;
+	size_t FindPage(size_t node, size_t first, size_t last, size_t start, int width_class, int height) const;
 
 public:
 	RectPacker(int pagewidth, int pageheight);
 	~RectPacker();
 
-	const Rect& Place(int width, int height, int padding = 0);
+	Rect Place(int width, int height, int padding = 0);
+
+	// places all rects at once, tallest first, which packs them
+	// tighter than one by one; result is in order of sizes
+	std::vector<Rect> Place(const std::vector<Size>& sizes, int padding = 0);
+
+	// mark next count pages as fully occupied
+	void SkipPages(int count);
+
+	int GetNumPages() const;
+
+	// part of page area occupied by placed rects (with padding), 0..1
+	float GetOccupancy(int page) const;
 };
 
 #endif // RECTPACKER_HH
@@ -17,13 +17,13 @@
  * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <iostream>
 
 #include <game/game.hh>
 #include <game/levelloader.hh>
 #include <graphics/spritemanager.hh>
-#include <graphics/objectsorter.hh>
 #include <graphics/camera.hh>
 
 #include <gameobjects/building.hh>
@@ -34,6 +34,8 @@
 
 #include <graphics/renderer.hh>
 
+const int Renderer::default_cull_margin_ = 128;
+
 Renderer::Renderer(SpriteManager& spriteman)
 	: sprite_manager_(spriteman),
 	  sprite_shadow_(spriteman, "SHADOWS"),
@@ -45,7 +47,8 @@ Renderer::Renderer(SpriteManager& spriteman)
 	  sprite_explo_gun_ground_(spriteman, "SMALLARM", 6, 6),
 	  sprite_explo_hydra_(spriteman, "EXPLODE", {14, 15, 19, 20, 21}), // XXX: from Desert Strike; yes, explosion anims are non-contigous
 	  sprite_explo_hellfire_(spriteman, "EXPLODE", {14, 15, 0, 1, 2, 22, 1, 0, 19, 20, 21}),
-	  sprite_explo_boom_(spriteman, "EXPLODE", {0, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}) {
+	  sprite_explo_boom_(spriteman, "EXPLODE", {0, 1, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13}),
+	  cull_margin_(default_cull_margin_) {
 
 	// Load all heli sprite sets
 	std::string heli_letters = "AP"; // XXX: only Desert Strike for now
@@ -55,18 +58,36 @@ Renderer::Renderer(SpriteManager& spriteman)
 	for (int forward = -1; forward <= 2; forward++)
 		for (int side = -1; side <= 1; side++)
 			GetHeliSprite(forward, side).reset(new SpriteManager::DirectionalSprite(spriteman, heli_letters + forward_letters[forward + 1] + side_letters[side + 1]));
+
+	if (sprite_manager_.GetRenderer().TargetSupported()) {
+		building_layer_.reset(new BuildingLayer(sprite_manager_.GetRenderer(), block_maps_));
+#if !defined DEBUG_RENDERING
+		// when debugging, buildings still go through the sorter
+		// so their bboxes are drawn on top of the layer
+		sorter_.SetIncludeBuildings(false);
+#endif
+	}
 }
 
-void Renderer::Render(Game& game, const Camera& camera) {
-	ObjectSorter sorter;
-	game.Accept(sorter);
+void Renderer::Render(Game& game, const Camera& camera, float interpolation) {
+	// static buildings go below all other objects
+	if (building_layer_)
+		building_layer_->Render(game, camera);
 
-	RenderVisitor renderer(*this, camera);
-	sorter.Accept(renderer);
+	sorter_.Clear();
+	sorter_.SetVisibleArea(camera.GetVisibleMin(cull_margin_), camera.GetVisibleMax(cull_margin_));
+	game.Accept(sorter_);
+
+	RenderVisitor renderer(*this, camera, interpolation);
+	sprite_manager_.BeginBatch();
+	sorter_.Accept(renderer);
+	sprite_manager_.EndBatch();
 }
 
 void Renderer::SubscribeToLoader(LevelLoader& loader) {
 	loader.AddBuildingTypeProcessor([this](unsigned short id, const DatLevel::BuildingType& type) {
+		cull_margin_ = std::max(cull_margin_, std::max<int>(type.width, type.height));
+
 		block_maps_.emplace(
 			std::make_pair(
 				id,
@@ -81,7 +102,7 @@ std::unique_ptr<SpriteManager::DirectionalSprite>& Renderer::GetHeliSprite(int f
 	return sprite_heli_[(forward + 1) * 3 + (side + 1)];
 }
 
-Renderer::RenderVisitor::RenderVisitor(Renderer& parent, const Camera& camera) : parent_(parent), camera_(camera) {
+Renderer::RenderVisitor::RenderVisitor(Renderer& parent, const Camera& camera, float interpolation) : parent_(parent), camera_(camera), interpolation_(interpolation) {
 }
 
 void Renderer::RenderVisitor::Visit(GameObject&) {
@@ -113,8 +134,10 @@ void Renderer::RenderVisitor::Visit(Heli& heli) {
 	// axe; this is distance between these
 	static const int heli_pivot_height = 16;
 
-	SDL2pp::Point heli_pos = camera_.GameToScreen(heli.GetPos());
-	SDL2pp::Point shadow_pos = camera_.GameToScreen(heli.GetPos().Grounded());
+	Vector3f pos = heli.GetInterpolatedPos(interpolation_);
+
+	SDL2pp::Point heli_pos = camera_.GameToScreen(pos);
+	SDL2pp::Point shadow_pos = camera_.GameToScreen(pos.Grounded());
 
 	// XXX: shadow should be transparent
 	parent_.sprite_shadow_.Render(shadow_pos.GetX(), shadow_pos.GetY(), heli.GetDirection().yaw);
@@ -123,7 +146,7 @@ void Renderer::RenderVisitor::Visit(Heli& heli) {
 }
 
 void Renderer::RenderVisitor::Visit(Projectile& projectile) {
-	SDL2pp::Point pos = camera_.GameToScreen(projectile.GetPos());
+	SDL2pp::Point pos = camera_.GameToScreen(projectile.GetInterpolatedPos(interpolation_));
 
 	switch (projectile.GetType()) {
 	case Projectile::BULLET:
@@ -160,12 +183,16 @@ void Renderer::RenderVisitor::Visit(Explosion& explosion) {
 void Renderer::RenderVisitor::Visit(Building& building) {
 	SDL2pp::Point pos = camera_.GameToScreen(building.GetPos() + building.GetSpriteOffset());
 
-	auto blockmap = parent_.block_maps_.find(building.GetType());
-	assert(blockmap != parent_.block_maps_.end());
+	// already drawn as a part of building layer
+	if (!parent_.building_layer_) {
+		auto blockmap = parent_.block_maps_.find(building.GetType());
+		assert(blockmap != parent_.block_maps_.end());
 
-	blockmap->second.Render(pos.GetX(), pos.GetY());
+		blockmap->second.Render(pos.GetX(), pos.GetY());
+	}
 
 #ifdef DEBUG_RENDERING
+	parent_.sprite_manager_.Flush();
 	parent_.sprite_manager_.GetRenderer().SetDrawColor(255, 255, 0);
 	building.ForeachBBox([this](const BBoxf& bbox) {
 		bbox.ForEachEdge([this](const Vector3f& a, const Vector3f& b){
@@ -186,6 +213,7 @@ void Renderer::RenderVisitor::Visit(Building& building) {
 
 void Renderer::RenderVisitor::Visit(Unit& unit) {
 #ifdef DEBUG_RENDERING
+	parent_.sprite_manager_.Flush();
 	parent_.sprite_manager_.GetRenderer().SetDrawColor(0, 0, 255);
 
 	parent_.sprite_manager_.GetRenderer().DrawLine(
@@ -25,6 +25,8 @@
 
 #include <game/visitor.hh>
 #include <graphics/spritemanager.hh>
+#include <graphics/objectsorter.hh>
+#include <graphics/buildinglayer.hh>
 
 class SpriteManager;
 class LevelLoader;
@@ -48,16 +50,27 @@ protected:
 	SpriteManager::Animation sprite_explo_hellfire_;
 	SpriteManager::Animation sprite_explo_boom_;
 
-	std::map<unsigned short, SpriteManager::BlockMap> block_maps_;
+	BuildingLayer::BlockMapMap block_maps_;
+
+	// null if render targets are not supported
+	std::unique_ptr<BuildingLayer> building_layer_;
+
+	ObjectSorter sorter_; // reused between frames
+
+	// how far out of the screen object position may be while
+	// its sprite is still visible; grows with largest building
+	static const int default_cull_margin_;
+	int cull_margin_;
 
 protected:
 	class RenderVisitor : public Visitor {
 	protected:
 		Renderer& parent_;
 		const Camera& camera_;
+		float interpolation_;
 
 	public:
-		RenderVisitor(Renderer& parent, const Camera& camera);
+		RenderVisitor(Renderer& parent, const Camera& camera, float interpolation);
 
 		virtual void Visit(GameObject& obj);
 
@@ -75,7 +88,9 @@ public:
 	Renderer(SpriteManager& spriteman);
 
 	void SubscribeToLoader(LevelLoader& loader);
-	void Render(Game& game, const Camera& camera);
+	// interpolation is between previous and current object
+	// positions, as returned by Game::GetInterpolation()
+	void Render(Game& game, const Camera& camera, float interpolation = 1.0f);
 };
 
 #endif
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <utility>
+
+#include <SDL2pp/Exception.hh>
+
+#include <graphics/spritebatch.hh>
+
+SpriteBatch::SpriteBatch(SDL2pp::Renderer& renderer)
+	: renderer_(renderer),
+	  texture_(nullptr),
+	  texture_width_(0.0f),
+	  texture_height_(0.0f) {
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+void SpriteBatch::Add(SDL2pp::Texture& texture, const SDL2pp::Rect& src, const SDL2pp::Rect& dst, bool hflip) {
+	if (&texture != texture_) {
+		Flush();
+		texture_ = &texture;
+		texture_width_ = texture.GetWidth();
+		texture_height_ = texture.GetHeight();
+	}
+
+	float u1 = src.GetX() / texture_width_;
+	float v1 = src.GetY() / texture_height_;
+	float u2 = (src.GetX() + src.GetW()) / texture_width_;
+	float v2 = (src.GetY() + src.GetH()) / texture_height_;
+
+	if (hflip)
+		std::swap(u1, u2);
+
+	float x1 = dst.GetX();
+	float y1 = dst.GetY();
+	float x2 = dst.GetX() + dst.GetW();
+	float y2 = dst.GetY() + dst.GetH();
+
+	const SDL_Color white = { 255, 255, 255, 255 };
+
+	int first = vertices_.size();
+	vertices_.push_back(SDL_Vertex{ { x1, y1 }, white, { u1, v1 } });
+	vertices_.push_back(SDL_Vertex{ { x2, y1 }, white, { u2, v1 } });
+	vertices_.push_back(SDL_Vertex{ { x2, y2 }, white, { u2, v2 } });
+	vertices_.push_back(SDL_Vertex{ { x1, y2 }, white, { u1, v2 } });
+
+	for (int index : { 0, 1, 2, 0, 2, 3 })
+		indices_.push_back(first + index);
+}
+
+void SpriteBatch::Flush() {
+	if (vertices_.empty())
+		return;
+
+	if (SDL_RenderGeometry(renderer_.Get(), texture_->Get(), vertices_.data(), vertices_.size(), indices_.data(), indices_.size()) != 0)
+		throw SDL2pp::Exception("SDL_RenderGeometry");
+
+	vertices_.clear();
+	indices_.clear();
+
+	// texture may be destroyed after it's drawn
+	texture_ = nullptr;
+}
+#else
+void SpriteBatch::Add(SDL2pp::Texture& texture, const SDL2pp::Rect& src, const SDL2pp::Rect& dst, bool hflip) {
+	renderer_.Copy(texture, src, dst, 0.0, SDL2pp::NullOpt, hflip ? SDL_FLIP_HORIZONTAL : SDL_FLIP_NONE);
+}
+
+void SpriteBatch::Flush() {
+}
+#endif
@@ -0,0 +1,63 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPRITEBATCH_HH
+#define SPRITEBATCH_HH
+
+#include <vector>
+
+#include <SDL2/SDL_render.h>
+#include <SDL2/SDL_version.h>
+
+#include <SDL2pp/Renderer.hh>
+#include <SDL2pp/Texture.hh>
+#include <SDL2pp/Rect.hh>
+
+// Accumulates textured quads and draws consecutive quads from the
+// same texture with a single SDL_RenderGeometry call, so drawing
+// order is preserved; falls back to a copy per quad on SDL older
+// than 2.0.18
+class SpriteBatch {
+protected:
+	SDL2pp::Renderer& renderer_;
+
+	SDL2pp::Texture* texture_;
+	float texture_width_;
+	float texture_height_;
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+	std::vector<SDL_Vertex> vertices_;
+	std::vector<int> indices_;
+#endif
+
+public:
+	SpriteBatch(SDL2pp::Renderer& renderer);
+
+	SpriteBatch(const SpriteBatch&) = delete;
+	SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+	// horizontal flip is done by swapping texture coordinates;
+	// texture must stay alive and in place until next Flush()
+	void Add(SDL2pp::Texture& texture, const SDL2pp::Rect& src, const SDL2pp::Rect& dst, bool hflip = false);
+
+	// draws everything accumulated so far
+	void Flush();
+};
+
+#endif // SPRITEBATCH_HH
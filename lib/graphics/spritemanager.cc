@@ -19,6 +19,13 @@
 
 #include <cassert>
 #include <set>
+#include <memory>
+#include <fstream>
+#include <iostream>
+#include <cstdio>
+#include <thread>
+#include <atomic>
+#include <algorithm>
 
 #include <SDL2/SDL_stdinc.h> // XXX <- this should be in SDL_pixels.h
 #include <SDL2/SDL_pixels.h>
@@ -26,20 +33,32 @@
 
 #include <dat/datgraphics.hh>
 #include <dat/datfile.hh>
+#include <dat/mappedfile.hh>
 
 #include <graphics/spritemanager.hh>
 
 const int SpriteManager::atlas_page_width_ = 512;
 const int SpriteManager::atlas_page_height_ = 512;
+// XXX: padding is required when SDL_RenderSetLogicalSize is used
+// XXX: otherwise parts of adjacent sprites are occasionally shown; investigate
+const int SpriteManager::atlas_padding_ = 1;
 
-SpriteManager::SpriteManager(SDL2pp::Renderer& renderer, DatFile& datfile) : renderer_(renderer), datfile_(datfile), rect_packer_(atlas_page_width_, atlas_page_width_) {
+const std::string SpriteManager::cache_magic_ = "OSATLAS1";
+
+static void AppendDWord(Buffer& buffer, uint32_t value) {
+	// same byte order as read by MemRange::GetDWord()
+	for (int i = 0; i < 4; i++)
+		buffer.Append((value >> (i * 8)) & 0xff);
+}
+
+SpriteManager::SpriteManager(SDL2pp::Renderer& renderer, DatFile& datfile) : renderer_(renderer), datfile_(datfile), rect_packer_(atlas_page_width_, atlas_page_width_), batch_(renderer), batch_depth_(0) {
 }
 
 SpriteManager::~SpriteManager() {
 }
 
 void SpriteManager::LoadAll(const LoadingStatusCallback& statuscb) {
-	int numloaded = 0, numtoload = 0;
+	int numtoload = 0;
 
 	// gather sprites to load, grouped by resource
 	std::map<std::string, std::set<sprite_id_t>> toload;
@@ -55,17 +74,126 @@ void SpriteManager::LoadAll(const LoadingStatusCallback& statuscb) {
 	if (statuscb)
 		statuscb(0, numtoload);
 
-	// load
+	// cached atlas covers the whole set of sprites, so it's
+	// only usable if nothing was loaded yet
+	bool use_cache = !cache_path_.empty() && numtoload > 0 && numtoload == (int)sprites_.size();
+	uint64_t dat_checksum = 0;
+	if (use_cache) {
+		dat_checksum = datfile_.GetChecksum();
+		if (LoadCache(dat_checksum)) {
+			if (statuscb)
+				statuscb(numtoload, numtoload);
+			return;
+		}
+	}
+
+	// unpacking and parsing is done by worker threads
+	struct Resource {
+		std::string name;
+		std::vector<sprite_id_t> ids;
+		std::shared_ptr<const Buffer> data;
+		std::unique_ptr<DatGraphics> graphics;
+
+		// sprites which got into free space of pages
+		// created before; rare, uploaded one by one
+		std::vector<std::pair<sprite_id_t, std::vector<unsigned char>>> late_sprites;
+	};
+
+	std::vector<Resource> resources(toload.size());
+	size_t nresource = 0;
 	for (auto& resource : toload) {
-		Buffer data = datfile_.GetData(resource.first);
-		DatGraphics gfx(data);
+		resources[nresource].name = resource.first;
+		resources[nresource].ids.assign(resource.second.begin(), resource.second.end());
+		nresource++;
+	}
 
-		for (auto& sprite : resource.second) {
-			Load(sprite, gfx);
-			if (statuscb)
-				statuscb(++numloaded, numtoload);
+	if (!workers_)
+		workers_.reset(new WorkerPool(std::max(std::thread::hardware_concurrency(), 1u) - 1));
+
+	workers_->Run(resources.size(), [this, &resources](size_t i) {
+		resources[i].data = datfile_.GetData(resources[i].name);
+		resources[i].graphics.reset(new DatGraphics(*resources[i].data));
+	});
+
+	// placement only needs sprite dimensions and is done here in
+	// fixed order, so atlas layout does not depend on scheduling;
+	// sprites are placed all at once, which packs them tighter
+	size_t first_new_page = atlas_pages_.size();
+	std::vector<sprite_id_t> toplace;
+	std::vector<RectPacker::Size> sizes;
+	for (auto& resource : resources) {
+		for (auto& id : resource.ids) {
+			SetDimensions(id, *resource.graphics);
+
+			const SpriteInfo& sprite = sprites_[id];
+			if (sprite.width != 0 || sprite.height != 0) {
+				toplace.push_back(id);
+				sizes.emplace_back(sprite.width, sprite.height);
+			}
 		}
 	}
+
+	std::vector<RectPacker::Rect> placed = rect_packer_.Place(sizes, atlas_padding_);
+	for (size_t i = 0; i < toplace.size(); i++)
+		SetPlacement(toplace[i], placed[i]);
+
+	// new pages are decoded into in-memory copies directly, which
+	// are then uploaded as a whole; placed rects do not overlap,
+	// so workers never write the same pixels
+	AtlasStagingVector staging(atlas_pages_.size() - first_new_page, std::vector<unsigned char>(atlas_page_width_ * atlas_page_height_ * 4, 0));
+
+	// sprites are counted as loaded once decoded, status callback
+	// is called from this thread while workers are busy
+	std::atomic<int> numdecoded(0);
+
+	auto decode = [this, &resources, &staging, &numdecoded, first_new_page](size_t i) {
+		Resource& resource = resources[i];
+		for (auto& id : resource.ids) {
+			const SpriteInfo& sprite = sprites_[id];
+
+			if (sprite.width == 0 && sprite.height == 0)
+				continue;
+
+			if (sprite.atlaspage >= first_new_page) {
+				unsigned char* dest = staging[sprite.atlaspage - first_new_page].data() + (sprite.atlasy * atlas_page_width_ + sprite.atlasx) * 4;
+				resource.graphics->GetPixels(sprite.frame, dest, atlas_page_width_ * 4);
+			} else {
+				resource.late_sprites.emplace_back(id, resource.graphics->GetPixels(sprite.frame));
+			}
+		}
+
+		// source data is no longer needed
+		resource.graphics.reset();
+		resource.data.reset();
+
+		numdecoded += resource.ids.size();
+	};
+
+	if (statuscb)
+		workers_->Run(resources.size(), decode, [&statuscb, &numdecoded, numtoload]() {
+			statuscb(numdecoded, numtoload);
+		});
+	else
+		workers_->Run(resources.size(), decode);
+
+	for (size_t page = 0; page < staging.size(); page++)
+		atlas_pages_[first_new_page + page].Update(SDL2pp::NullOpt, staging[page].data(), atlas_page_width_ * 4);
+
+	for (auto& resource : resources) {
+		for (auto& late_sprite : resource.late_sprites) {
+			const SpriteInfo& sprite = sprites_[late_sprite.first];
+			atlas_pages_[sprite.atlaspage].Update(SDL2pp::Rect(sprite.atlasx, sprite.atlasy, sprite.width, sprite.height), late_sprite.second.data(), sprite.width * 4);
+		}
+
+		for (auto& id : resource.ids)
+			sprites_[id].loaded = true;
+	}
+
+	if (statuscb)
+		statuscb(numtoload, numtoload);
+
+	if (use_cache && first_new_page == 0)
+		SaveCache(dat_checksum, staging);
 }
 
 SpriteManager::sprite_id_t SpriteManager::Add(const std::string& resource, unsigned int frame, bool load_immediately) {
@@ -114,21 +242,15 @@ void SpriteManager::Render(sprite_id_t id, int x, int y, int flags) {
 		}
 	}
 
-	if (flags & HFLIP_SPRITE) {
-		renderer_.Copy(
-				atlas_pages_[sprite.atlaspage],
-				SDL2pp::Rect(sprite.atlasx, sprite.atlasy, sprite.width, sprite.height),
-				SDL2pp::Rect(x + xoffset, y + yoffset, sprite.width, sprite.height),
-				0.0,
-				SDL2pp::NullOpt,
-				SDL_FLIP_HORIZONTAL
-			);
+	SDL2pp::Rect src(sprite.atlasx, sprite.atlasy, sprite.width, sprite.height);
+	SDL2pp::Rect dst(x + xoffset, y + yoffset, sprite.width, sprite.height);
+
+	if (batch_depth_ > 0) {
+		batch_.Add(atlas_pages_[sprite.atlaspage], src, dst, flags & HFLIP_SPRITE);
+	} else if (flags & HFLIP_SPRITE) {
+		renderer_.Copy(atlas_pages_[sprite.atlaspage], src, dst, 0.0, SDL2pp::NullOpt, SDL_FLIP_HORIZONTAL);
 	} else {
-		renderer_.Copy(
-				atlas_pages_[sprite.atlaspage],
-				SDL2pp::Rect(sprite.atlasx, sprite.atlasy, sprite.width, sprite.height),
-				SDL2pp::Rect(x + xoffset, y + yoffset, sprite.width, sprite.height)
-			);
+		renderer_.Copy(atlas_pages_[sprite.atlaspage], src, dst);
 	}
 }
 
@@ -136,30 +258,21 @@ const SpriteManager::SpriteInfo& SpriteManager::GetSpriteInfo(sprite_id_t id) co
 	return sprites_[id];
 }
 
-void SpriteManager::Load(SpriteManager::sprite_id_t id, const DatGraphics& graphics) {
+void SpriteManager::SetDimensions(sprite_id_t id, const DatGraphics& graphics) {
 	SpriteInfo& sprite = sprites_[id];
+	DatGraphics::Sprite frame = graphics.GetSprite(sprite.frame);
+
+	sprite.width = frame.width;
+	sprite.height = frame.height;
+	sprite.xoffset = frame.xoffset;
+	sprite.yoffset = frame.yoffset;
+	sprite.framewidth = frame.framewidth;
+	sprite.frameheight = frame.frameheight;
+}
 
-	if (sprite.loaded)
-		return;
-
-	unsigned int nframe = sprite.frame;
-
-	sprite.width = graphics.GetWidth(nframe);
-	sprite.height = graphics.GetHeight(nframe);
-	sprite.xoffset = graphics.GetXOffset(nframe);
-	sprite.yoffset = graphics.GetYOffset(nframe);
-	sprite.framewidth = graphics.GetFrameWidth(nframe);
-	sprite.frameheight = graphics.GetFrameHeight(nframe);
-
-	if (sprite.width == 0 && sprite.height == 0) {
-		sprite.loaded = true;
-		return;
-	}
+void SpriteManager::SetPlacement(sprite_id_t id, const RectPacker::Rect& placed) {
+	SpriteInfo& sprite = sprites_[id];
 
-	// place sprite in atlas
-	// XXX: padding is required when SDL_RenderSetLogicalSize is used
-	// XXX: otherwise parts of adjacent sprites are occasionally shown; investigate
-	const RectPacker::Rect& placed = rect_packer_.Place(sprite.width, sprite.height, 1);
 	sprite.atlaspage = placed.page;
 	sprite.atlasx = placed.x;
 	sprite.atlasy = placed.y;
@@ -169,10 +282,31 @@ void SpriteManager::Load(SpriteManager::sprite_id_t id, const DatGraphics& graph
 		atlas_pages_.emplace_back(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, atlas_page_width_, atlas_page_height_);
 		atlas_pages_.back().SetBlendMode(SDL_BLENDMODE_BLEND);
 	}
+}
+
+void SpriteManager::Place(sprite_id_t id, const DatGraphics& graphics) {
+	SetDimensions(id, graphics);
+
+	const SpriteInfo& sprite = sprites_[id];
+	if (sprite.width == 0 && sprite.height == 0)
+		return;
+
+	SetPlacement(id, rect_packer_.Place(sprite.width, sprite.height, atlas_padding_));
+}
+
+void SpriteManager::Load(SpriteManager::sprite_id_t id, const DatGraphics& graphics) {
+	SpriteInfo& sprite = sprites_[id];
+
+	if (sprite.loaded)
+		return;
+
+	Place(id, graphics);
 
 	// Write pixels to texture
-	std::vector<unsigned char> pixels = graphics.GetPixels(nframe);
-	atlas_pages_[sprite.atlaspage].Update(SDL2pp::Rect(sprite.atlasx, sprite.atlasy, sprite.width, sprite.height), pixels.data(), sprite.width * 4);
+	if (sprite.width != 0 || sprite.height != 0) {
+		std::vector<unsigned char> pixels = graphics.GetPixels(sprite.frame);
+		atlas_pages_[sprite.atlaspage].Update(SDL2pp::Rect(sprite.atlasx, sprite.atlasy, sprite.width, sprite.height), pixels.data(), sprite.width * 4);
+	}
 
 	// Done
 	sprite.loaded = true;
@@ -184,12 +318,183 @@ void SpriteManager::Load(SpriteManager::sprite_id_t id) {
 	if (sprite.loaded)
 		return;
 
-	Buffer data = datfile_.GetData(sprite.resource);
-	DatGraphics gfx(data);
+	std::shared_ptr<const Buffer> data = datfile_.GetData(sprite.resource);
+	DatGraphics gfx(*data);
 
 	Load(id, gfx);
 }
 
+uint64_t SpriteManager::GetSpritesChecksum() const {
+	Buffer description;
+
+	AppendDWord(description, atlas_page_width_);
+	AppendDWord(description, atlas_page_height_);
+
+	for (auto& sprite : sprites_) {
+		description.Append(reinterpret_cast<const unsigned char*>(sprite.resource.data()), sprite.resource.size());
+		description.Append(0);
+		AppendDWord(description, sprite.frame);
+	}
+
+	return description.GetChecksum();
+}
+
+bool SpriteManager::LoadCache(uint64_t dat_checksum) {
+	std::unique_ptr<MappedFile> cache;
+	try {
+		cache.reset(new MappedFile(cache_path_));
+	} catch (std::runtime_error&) {
+		return false; // not created yet
+	}
+
+	// validate everything before touching any state
+	if (cache->GetSize() < CacheFileStruct::Header::size)
+		return false;
+
+	Slice header = cache->GetSlice(0, CacheFileStruct::Header::size);
+
+	if (header.GetString(CacheFileStruct::Header::offs_magic, cache_magic_.size()) != cache_magic_)
+		return false;
+	if (header.GetQWord(CacheFileStruct::Header::offs_dat_checksum) != dat_checksum)
+		return false;
+	if (header.GetQWord(CacheFileStruct::Header::offs_sprites_checksum) != GetSpritesChecksum())
+		return false;
+	if (header.GetDWord(CacheFileStruct::Header::offs_num_sprites) != sprites_.size())
+		return false;
+	if (header.GetDWord(CacheFileStruct::Header::offs_page_width) != (unsigned int)atlas_page_width_)
+		return false;
+	if (header.GetDWord(CacheFileStruct::Header::offs_page_height) != (unsigned int)atlas_page_height_)
+		return false;
+
+	unsigned int num_pages = header.GetDWord(CacheFileStruct::Header::offs_num_pages);
+	size_t page_size = atlas_page_width_ * atlas_page_height_ * 4;
+	size_t sprites_offset = CacheFileStruct::Header::size;
+	size_t pages_offset = sprites_offset + sprites_.size() * CacheFileStruct::Sprite::size;
+
+	if (cache->GetSize() != pages_offset + num_pages * page_size)
+		return false;
+
+	SpriteInfoVector sprites = sprites_;
+	for (size_t id = 0; id < sprites.size(); id++) {
+		Slice record = cache->GetSlice(sprites_offset + id * CacheFileStruct::Sprite::size, CacheFileStruct::Sprite::size);
+		SpriteInfo& sprite = sprites[id];
+
+		sprite.width = record.GetDWord(0);
+		sprite.height = record.GetDWord(4);
+		sprite.xoffset = record.GetDWord(8);
+		sprite.yoffset = record.GetDWord(12);
+		sprite.framewidth = record.GetDWord(16);
+		sprite.frameheight = record.GetDWord(20);
+		sprite.atlaspage = record.GetDWord(24);
+		sprite.atlasx = record.GetDWord(28);
+		sprite.atlasy = record.GetDWord(32);
+		sprite.loaded = true;
+
+		if (sprite.width == 0 && sprite.height == 0)
+			continue;
+
+		if (sprite.atlaspage >= num_pages || sprite.atlasx + sprite.width > (unsigned int)atlas_page_width_ || sprite.atlasy + sprite.height > (unsigned int)atlas_page_height_)
+			return false;
+	}
+
+	// upload pages as is
+	for (unsigned int page = 0; page < num_pages; page++) {
+		atlas_pages_.emplace_back(renderer_, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, atlas_page_width_, atlas_page_height_);
+		atlas_pages_.back().SetBlendMode(SDL_BLENDMODE_BLEND);
+		atlas_pages_.back().Update(SDL2pp::NullOpt, cache->GetData() + pages_offset + page * page_size, atlas_page_width_ * 4);
+	}
+
+	// sprites loaded later go to new pages
+	rect_packer_.SkipPages(num_pages);
+
+	sprites_.swap(sprites);
+
+	return true;
+}
+
+void SpriteManager::SaveCache(uint64_t dat_checksum, const AtlasStagingVector& pages) const {
+	Buffer header;
+
+	header.Append(reinterpret_cast<const unsigned char*>(cache_magic_.data()), cache_magic_.size());
+	AppendDWord(header, dat_checksum & 0xffffffff);
+	AppendDWord(header, dat_checksum >> 32);
+	AppendDWord(header, GetSpritesChecksum() & 0xffffffff);
+	AppendDWord(header, GetSpritesChecksum() >> 32);
+	AppendDWord(header, sprites_.size());
+	AppendDWord(header, pages.size());
+	AppendDWord(header, atlas_page_width_);
+	AppendDWord(header, atlas_page_height_);
+
+	for (auto& sprite : sprites_) {
+		bool empty = sprite.width == 0 && sprite.height == 0;
+
+		AppendDWord(header, sprite.width);
+		AppendDWord(header, sprite.height);
+		AppendDWord(header, sprite.xoffset);
+		AppendDWord(header, sprite.yoffset);
+		AppendDWord(header, sprite.framewidth);
+		AppendDWord(header, sprite.frameheight);
+		AppendDWord(header, empty ? 0 : sprite.atlaspage);
+		AppendDWord(header, empty ? 0 : sprite.atlasx);
+		AppendDWord(header, empty ? 0 : sprite.atlasy);
+	}
+
+	// write to temporary file first, so concurrent or interrupted
+	// run never sees partially written cache
+	std::string temp_path = cache_path_ + ".tmp";
+	{
+		std::ofstream file(temp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+		file.write(reinterpret_cast<const char*>(header.GetData()), header.GetSize());
+		for (auto& page : pages)
+			file.write(reinterpret_cast<const char*>(page.data()), page.size());
+
+		if (!file) {
+			std::cerr << "Warning: cannot write atlas cache " << temp_path << std::endl;
+			file.close();
+			std::remove(temp_path.c_str());
+			return;
+		}
+	}
+
+	if (std::rename(temp_path.c_str(), cache_path_.c_str()) != 0) {
+		std::cerr << "Warning: cannot write atlas cache " << cache_path_ << std::endl;
+		std::remove(temp_path.c_str());
+	}
+}
+
+void SpriteManager::SetCacheFile(const std::string& path) {
+	cache_path_ = path;
+}
+
 SDL2pp::Renderer& SpriteManager::GetRenderer() {
 	return renderer_;
 }
+
+unsigned int SpriteManager::GetNumAtlasPages() const {
+	return atlas_pages_.size();
+}
+
+float SpriteManager::GetAtlasOccupancy(unsigned int page) const {
+	// computed from sprites, as pages may come from cache
+	int used_area = 0;
+	for (auto& sprite : sprites_)
+		if (sprite.loaded && sprite.atlaspage == page && (sprite.width != 0 || sprite.height != 0))
+			used_area += (sprite.width + atlas_padding_ * 2) * (sprite.height + atlas_padding_ * 2);
+
+	return (float)used_area / (float)(atlas_page_width_ * atlas_page_height_);
+}
+
+void SpriteManager::BeginBatch() {
+	batch_depth_++;
+}
+
+void SpriteManager::EndBatch() {
+	assert(batch_depth_ > 0);
+	if (--batch_depth_ == 0)
+		batch_.Flush();
+}
+
+void SpriteManager::Flush() {
+	batch_.Flush();
+}
@@ -21,14 +21,20 @@
 #define SPRITEMANAGER_HH
 
 #include <vector>
+#include <deque>
+#include <span>
 #include <map>
 #include <functional>
 #include <string>
+#include <cstdint>
 
 #include <SDL2pp/Texture.hh>
 #include <SDL2pp/Renderer.hh>
 
+#include <game/workerpool.hh>
+
 #include <graphics/rectpacker.hh>
+#include <graphics/spritebatch.hh>
 
 class DatGraphics;
 class DatFile;
@@ -109,9 +115,12 @@ public:
 		int height_;
 
 	public:
-		BlockMap(SpriteManager& manager, const std::string& name, const std::vector<unsigned short>& blocks, int width, int height, int flags = PIVOT_FRAMECORNER);
+		BlockMap(SpriteManager& manager, const std::string& name, std::span<const unsigned short> blocks, int width, int height, int flags = PIVOT_FRAMECORNER);
 
 		void Render(int x, int y);
+
+		int GetWidth() const;
+		int GetHeight() const;
 	};
 
 	class TextMap {
@@ -155,6 +164,25 @@ public:
 protected:
 	static const int atlas_page_width_;
 	static const int atlas_page_height_;
+	static const int atlas_padding_;
+
+	struct CacheFileStruct {
+		struct Header {
+			static const int size = 40;
+			static const int offs_magic = 0;
+			static const int offs_dat_checksum = 8;
+			static const int offs_sprites_checksum = 16;
+			static const int offs_num_sprites = 24;
+			static const int offs_num_pages = 28;
+			static const int offs_page_width = 32;
+			static const int offs_page_height = 36;
+		};
+		struct Sprite {
+			static const int size = 36; // 9 dwords, same order as in SpriteInfo
+		};
+	};
+
+	static const std::string cache_magic_;
 
 protected:
 	struct SpriteInfo {
@@ -178,7 +206,10 @@ protected:
 		}
 	};
 
-	typedef std::vector<SDL2pp::Texture> AtlasPageVector;
+	// pages stay in place when more are added, as batch_
+	// keeps reference to the one it's currently drawing from
+	typedef std::deque<SDL2pp::Texture> AtlasPageVector;
+	typedef std::vector<std::vector<unsigned char>> AtlasStagingVector;
 	typedef std::vector<SpriteInfo> SpriteInfoVector;
 	typedef std::pair<std::string, int> SpriteLocation;
 	typedef std::map<SpriteLocation, sprite_id_t> SpriteMap;
@@ -193,21 +224,55 @@ protected:
 
 	RectPacker rect_packer_;
 
+	std::string cache_path_;
+
+	SpriteBatch batch_;
+	int batch_depth_;
+
+	// resources are unpacked and decoded by these
+	std::unique_ptr<WorkerPool> workers_;
+
 protected:
 	sprite_id_t Add(const std::string& resource, unsigned int frame, bool load_immediately = false);
 	void Render(sprite_id_t id, int x, int y, int flags);
 	const SpriteInfo& GetSpriteInfo(sprite_id_t id) const;
 
+	void SetDimensions(sprite_id_t id, const DatGraphics& graphics);
+	void SetPlacement(sprite_id_t id, const RectPacker::Rect& placed);
+	void Place(sprite_id_t id, const DatGraphics& graphics);
+
 	void Load(sprite_id_t id, const DatGraphics& graphics);
 	void Load(sprite_id_t id);
 
+	uint64_t GetSpritesChecksum() const;
+	bool LoadCache(uint64_t dat_checksum);
+	void SaveCache(uint64_t dat_checksum, const AtlasStagingVector& pages) const;
+
 public:
 	SpriteManager(SDL2pp::Renderer& renderer, DatFile& datfile);
 	~SpriteManager();
 
+	// if set, LoadAll() reuses atlas pages stored in this file by
+	// previous run with the same .DAT file and set of sprites, or
+	// writes them there otherwise
+	void SetCacheFile(const std::string& path);
+
 	void LoadAll(const LoadingStatusCallback& statuscb = nullptr);
 
 	SDL2pp::Renderer& GetRenderer();
+
+	unsigned int GetNumAtlasPages() const;
+
+	// part of atlas page area used by sprites (with padding), 0..1
+	float GetAtlasOccupancy(unsigned int page) const;
+
+	// sprites rendered between these are accumulated and drawn with
+	// as few draw calls as possible; calls may be nested. Anything
+	// drawn directly through the renderer in between must be preceded
+	// by Flush()
+	void BeginBatch();
+	void EndBatch();
+	void Flush();
 };
 
 #endif // SPRITEMANAGER_HH
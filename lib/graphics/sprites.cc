@@ -93,7 +93,7 @@ unsigned int SpriteManager::Animation::GetNumFrames() const {
 	return ids_.size();
 }
 
-SpriteManager::BlockMap::BlockMap(SpriteManager& manager, const std::string& name, const std::vector<unsigned short>& blockids, int width, int height, int flags)
+SpriteManager::BlockMap::BlockMap(SpriteManager& manager, const std::string& name, std::span<const unsigned short> blockids, int width, int height, int flags)
 	: manager_(manager),
 	  flags_(flags),
 	  width_(width),
@@ -110,6 +110,7 @@ void SpriteManager::BlockMap::Render(int x, int y) {
 	if (ids_.empty()) {
 #endif
 		// fallback if no resource was specified: just render a frame
+		manager_.Flush();
 		SDL2pp::Renderer& renderer = manager_.GetRenderer();
 		renderer.SetDrawColor(0, 255, 0, 64);
 		renderer.DrawRect(SDL2pp::Rect(x, y, width_, height_));
@@ -120,6 +121,7 @@ void SpriteManager::BlockMap::Render(int x, int y) {
 
 	static const int blockwidth = 16, blockheight = 16;
 	int xpos = 0, ypos = 0;
+	manager_.BeginBatch();
 	for (auto& id : ids_) {
 		int flipflag = id.second ? SpriteManager::HFLIP : 0;
 		manager_.Render(id.first, x + xpos, y + ypos, flags_ ^ flipflag);
@@ -128,6 +130,15 @@ void SpriteManager::BlockMap::Render(int x, int y) {
 			ypos += blockheight;
 		}
 	}
+	manager_.EndBatch();
+}
+
+int SpriteManager::BlockMap::GetWidth() const {
+	return width_;
+}
+
+int SpriteManager::BlockMap::GetHeight() const {
+	return height_;
 }
 
 SpriteManager::TextMap::TextMap(SpriteManager& manager, const std::string& name, char firstchar, int firstframe, int nframes)
@@ -214,6 +225,7 @@ void SpriteManager::TextMap::Render(int x, int y, const std::string& text, int a
 		ypos -= descent_ - 1;
 
 	int pos = 0;
+	manager_.BeginBatch();
 	for (auto ch : text) {
 		if (pos++)
 			xpos++;
@@ -231,4 +243,5 @@ void SpriteManager::TextMap::Render(int x, int y, const std::string& text, int a
 		manager_.Render(GetChar(ch), xpos, ypos, PIVOT_FRAMECORNER);
 		xpos += manager_.GetSpriteInfo(GetChar(ch)).width;
 	}
+	manager_.EndBatch();
 }
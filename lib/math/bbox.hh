@@ -21,6 +21,7 @@
 #define BBOX_HH
 
 #include <algorithm>
+#include <utility>
 
 #include <math/geom.hh>
 
@@ -52,6 +53,54 @@ struct BBox {
 		return !(toPoint.x < left || toPoint.x > right || toPoint.y < front || toPoint.y > back);
 	}
 
+	// checks whether segment from..to intersects the box; if so, also
+	// returns the fraction of the segment (0 if from is already inside)
+	// at which it enters the box
+	bool IntersectSegment(const Vector3<T>& from, const Vector3<T>& to, T& time) const {
+		// in box coordinates, box is axis aligned, and as rotation
+		// is linear, fraction along the segment is preserved
+		Vector3<T> start = (from - pos) * Direction2<T>(-direction.yaw);
+		Vector3<T> delta = (to - pos) * Direction2<T>(-direction.yaw) - start;
+
+		T enter = 0, leave = 1;
+
+		const T starts[] = { start.x, start.y, start.z };
+		const T deltas[] = { delta.x, delta.y, delta.z };
+		const T mins[] = { left, front, bottom };
+		const T maxs[] = { right, back, top };
+
+		for (int axis = 0; axis < 3; axis++) {
+			if (deltas[axis] == 0) {
+				// parallel to slab
+				if (starts[axis] < mins[axis] || starts[axis] > maxs[axis])
+					return false;
+				continue;
+			}
+
+			T t1 = (mins[axis] - starts[axis]) / deltas[axis];
+			T t2 = (maxs[axis] - starts[axis]) / deltas[axis];
+			if (t1 > t2)
+				std::swap(t1, t2);
+
+			enter = std::max(enter, t1);
+			leave = std::min(leave, t2);
+
+			if (enter > leave)
+				return false;
+		}
+
+		time = enter;
+		return true;
+	}
+
+	bool IntersectSegment(const Vector3<T>& from, const Vector3<T>& to, T& time, Vector3<T>& point) const {
+		if (!IntersectSegment(from, to, time))
+			return false;
+
+		point = from + (to - from) * time;
+		return true;
+	}
+
 	template<class Fn>
 	void ForEachEdge(const Fn& fn) const {
 		Vector2<T> p0 = Vector2<T>(pos) + Vector2<T>(left, front) * direction;
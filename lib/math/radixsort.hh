@@ -0,0 +1,74 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef RADIXSORT_HH
+#define RADIXSORT_HH
+
+#include <vector>
+#include <bit>
+#include <cstdint>
+#include <cstddef>
+
+// Unsigned integer which compares the same way as given float
+inline uint32_t FloatToSortKey(float value) {
+	uint32_t bits = std::bit_cast<uint32_t>(value);
+	return (bits & 0x80000000) ? ~bits : (bits | 0x80000000);
+}
+
+// Stable LSD radix sort of items by 32 bit key returned by given
+// function; scratch is used as temporary storage, so both vectors
+// keep their memory and may be reused between calls
+template<class T, class KeyFunc>
+void RadixSort(std::vector<T>& items, std::vector<T>& scratch, KeyFunc key) {
+	static const int num_passes = 4;
+	static const int num_buckets = 256;
+
+	if (items.size() < 2)
+		return;
+
+	size_t counts[num_passes][num_buckets] = {};
+	for (const auto& item : items) {
+		uint32_t itemkey = key(item);
+		for (int pass = 0; pass < num_passes; pass++)
+			counts[pass][(itemkey >> (pass * 8)) & 0xff]++;
+	}
+
+	scratch.resize(items.size());
+
+	for (int pass = 0; pass < num_passes; pass++) {
+		// skip pass if all items fall into one bucket
+		size_t (&bucket_counts)[num_buckets] = counts[pass];
+		if (bucket_counts[(key(items.front()) >> (pass * 8)) & 0xff] == items.size())
+			continue;
+
+		size_t offsets[num_buckets];
+		size_t offset = 0;
+		for (int bucket = 0; bucket < num_buckets; bucket++) {
+			offsets[bucket] = offset;
+			offset += bucket_counts[bucket];
+		}
+
+		for (auto& item : items)
+			scratch[offsets[(key(item) >> (pass * 8)) & 0xff]++] = std::move(item);
+
+		items.swap(scratch);
+	}
+}
+
+#endif // RADIXSORT_HH
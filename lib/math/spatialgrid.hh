@@ -0,0 +1,128 @@
+/*
+ * Copyright (C) 2013-2014 Dmitry Marakasov
+ *
+ * This file is part of openstrike.
+ *
+ * openstrike is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * openstrike is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPATIALGRID_HH
+#define SPATIALGRID_HH
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <cmath>
+
+#include <math/geom.hh>
+
+// Uniform grid of objects' 2D extents, for finding objects
+// which may intersect given area without visiting all of them
+template<class T>
+class SpatialGrid {
+protected:
+	struct Entry {
+		T* object;
+		Vector2f min;
+		Vector2f max;
+
+		Entry(T* o, const Vector2f& mi, const Vector2f& ma) : object(o), min(mi), max(ma) {
+		}
+	};
+
+	typedef std::vector<Entry> Cell;
+	typedef std::map<const T*, std::pair<Vector2f, Vector2f>> ExtentsMap;
+
+protected:
+	float cell_size_;
+	int width_;
+	int height_;
+
+	std::vector<Cell> cells_;
+	ExtentsMap extents_;
+
+protected:
+	// points outside of the grid belong to edge cells
+	int GetCellX(float x) const {
+		return std::clamp((int)std::floor(x / cell_size_), 0, width_ - 1);
+	}
+
+	int GetCellY(float y) const {
+		return std::clamp((int)std::floor(y / cell_size_), 0, height_ - 1);
+	}
+
+	template<class F>
+	void ForeachCell(const Vector2f& min, const Vector2f& max, const F& fn) {
+		for (int y = GetCellY(min.y); y <= GetCellY(max.y); y++)
+			for (int x = GetCellX(min.x); x <= GetCellX(max.x); x++)
+				fn(cells_[y * width_ + x]);
+	}
+
+public:
+	SpatialGrid(float width, float height, float cell_size)
+		: cell_size_(cell_size),
+		  width_(std::max(1, (int)std::ceil(width / cell_size))),
+		  height_(std::max(1, (int)std::ceil(height / cell_size))),
+		  cells_(width_ * height_) {
+	}
+
+	// adds object or updates its extents
+	void Insert(T* object, const Vector2f& min, const Vector2f& max) {
+		Remove(object);
+
+		ForeachCell(min, max, [object, &min, &max](Cell& cell) {
+			cell.emplace_back(object, min, max);
+		});
+
+		extents_.emplace(object, std::make_pair(min, max));
+	}
+
+	void Remove(const T* object) {
+		typename ExtentsMap::iterator extents = extents_.find(object);
+		if (extents == extents_.end())
+			return;
+
+		ForeachCell(extents->second.first, extents->second.second, [object](Cell& cell) {
+			cell.erase(std::find_if(cell.begin(), cell.end(), [object](const Entry& entry) { return entry.object == object; }));
+		});
+
+		extents_.erase(extents);
+	}
+
+	// calls fn once for each object which extents intersect given area
+	template<class F>
+	void ForeachInArea(const Vector2f& min, const Vector2f& max, const F& fn) const {
+		for (int y = GetCellY(min.y); y <= GetCellY(max.y); y++) {
+			for (int x = GetCellX(min.x); x <= GetCellX(max.x); x++) {
+				for (auto& entry : cells_[y * width_ + x]) {
+					if (entry.min.x > max.x || entry.max.x < min.x || entry.min.y > max.y || entry.max.y < min.y)
+						continue;
+
+					// object spanning several cells is only reported
+					// from the first cell where it meets the area
+					if (GetCellX(std::max(min.x, entry.min.x)) != x || GetCellY(std::max(min.y, entry.min.y)) != y)
+						continue;
+
+					fn(*entry.object);
+				}
+			}
+		}
+	}
+
+	bool IsEmpty() const {
+		return extents_.empty();
+	}
+};
+
+#endif // SPATIALGRID_HH
@@ -19,6 +19,7 @@
 
 #include <iostream>
 #include <limits>
+#include <thread>
 
 #include <SDL2/SDL.h>
 
@@ -59,7 +60,11 @@ int realmain(int argc, char** argv) {
 	}
 
 	// Data file
-	DatFile datfile(argv[1]);
+	DatFile datfile(argv[1], DatFile::MMAP);
+
+	// keep recently unpacked entries (level data, THINGS table,
+	// lazily loaded sprite resources) around between loads
+	datfile.SetCacheLimit(16 * 1024 * 1024);
 
 	// SDL stuff
 	SDL2pp::SDL sdl(SDL_INIT_VIDEO);
@@ -71,6 +76,7 @@ int realmain(int argc, char** argv) {
 
 	// Game stuff
 	SpriteManager spriteman(renderer, datfile);
+	spriteman.SetCacheFile(std::string(argv[1]) + ".atlas");
 
 	Renderer game_renderer(spriteman);
 	GroundRenderer ground_renderer(renderer);
@@ -78,11 +84,14 @@ int realmain(int argc, char** argv) {
 	Camera camera(Vector3f(0, 0, 0), SDL2pp::Rect(0, 0, 320, 200));
 
 	LevelLoader level_loader;
+	level_loader.SetCachePrefix(std::string(argv[1]) + ".");
 	game_renderer.SubscribeToLoader(level_loader);
 
 	Game game = level_loader.Load(datfile, "LEVEL0", 12, 6); // sizes correspond to first level of Desert Strike
 	Heli* heli = game.Spawn<Heli>(Vector2f(512 * 3 + 256, 1024 * 1 + 256));
 
+	game.SetNumThreads(std::thread::hardware_concurrency());
+
 	// game_renderer has notified sprite manager of needed sprites,
 	// now it will load them
 	spriteman.LoadAll();
@@ -126,16 +135,19 @@ int realmain(int argc, char** argv) {
 		this_ms = SDL_GetTicks();
 		delta_ms = (prev_ms <= this_ms) ? (this_ms - prev_ms) : (std::numeric_limits<unsigned int>::max() - prev_ms + this_ms);
 
-		game.Update(delta_ms);
+		// simulation runs in fixed steps, independent of frame rate
+		game.Advance(delta_ms);
+
+		float interpolation = game.GetInterpolation();
 
-		camera.SetTarget(heli->GetPos().Grounded() + Vector3f(120, 0, 0));
+		camera.SetTarget(heli->GetInterpolatedPos(interpolation).Grounded() + Vector3f(120, 0, 0));
 
 		// Render
 		renderer.SetDrawColor(0, 0, 0);
 		renderer.Clear();
 
 		ground_renderer.Render(game, camera);
-		game_renderer.Render(game, camera);
+		game_renderer.Render(game, camera, interpolation);
 
 		renderer.Present();
 
@@ -20,4 +20,37 @@ BEGIN_TEST()
 	EXPECT_TRUE(!bbox.Contains(Vector3f(100 + 3.01, 100, 115))); // right
 	EXPECT_TRUE(!bbox.Contains(Vector3f(100, 100 - 4.01, 115))); // front
 	EXPECT_TRUE(!bbox.Contains(Vector3f(100, 100 + 2.01, 115))); // back
+
+	float time;
+	Vector3f point;
+
+	// segment entering through the left side
+	EXPECT_TRUE(bbox.IntersectSegment(Vector3f(90, 100, 115), Vector3f(110, 100, 115), time, point));
+	EXPECT_FLOAT_IN_RANGE(time, 0.449, 0.451);
+	EXPECT_FLOAT_IN_RANGE(point.x, 98.99, 99.01);
+
+	// segment crossing box completely, with both ends outside
+	EXPECT_TRUE(bbox.IntersectSegment(Vector3f(100, 200, 115), Vector3f(100, 0, 115), time));
+	EXPECT_FLOAT_IN_RANGE(time, 0.489, 0.491);
+
+	// falling from above
+	EXPECT_TRUE(bbox.IntersectSegment(Vector3f(101, 101, 130), Vector3f(101, 101, 90), time));
+	EXPECT_FLOAT_IN_RANGE(time, 0.249, 0.251);
+
+	// starting inside
+	EXPECT_TRUE(bbox.IntersectSegment(Vector3f(100, 100, 115), Vector3f(200, 200, 200), time));
+	EXPECT_FLOAT_IN_RANGE(time, 0.0, 0.0);
+
+	// misses: stopping short, passing aside, passing above, degenerate
+	EXPECT_TRUE(!bbox.IntersectSegment(Vector3f(90, 100, 115), Vector3f(98, 100, 115), time));
+	EXPECT_TRUE(!bbox.IntersectSegment(Vector3f(90, 110, 115), Vector3f(110, 110, 115), time));
+	EXPECT_TRUE(!bbox.IntersectSegment(Vector3f(90, 100, 121), Vector3f(110, 100, 121), time));
+	EXPECT_TRUE(!bbox.IntersectSegment(Vector3f(90, 100, 115), Vector3f(90, 100, 115), time));
+
+	// rotated box: diagonal of the square is longer than its side
+	BBoxf rotated(Vector3f(0, 0, 0), -10, -10, 10, 10, 0, 10, pi / 4);
+
+	EXPECT_TRUE(rotated.IntersectSegment(Vector3f(-20, 0, 5), Vector3f(20, 0, 5), time, point));
+	EXPECT_FLOAT_IN_RANGE(point.x, -14.15, -14.13);
+	EXPECT_TRUE(!rotated.IntersectSegment(Vector3f(-15, 15, 5), Vector3f(15, 15, 5), time));
 END_TEST()
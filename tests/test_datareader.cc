@@ -0,0 +1,44 @@
+#include <stdexcept>
+
+#include <dat/buffer.hh>
+#include <dat/datareader.hh>
+
+#include "testing.h"
+
+BEGIN_TEST()
+	static const unsigned char bytes[] = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0xfe, 0xff, 0x41, 0x42 };
+	Buffer buffer;
+	buffer.Append(bytes, sizeof(bytes));
+
+	DataReader reader(buffer);
+	EXPECT_INT(reader.GetSize(), 12);
+
+	// little-endian regardless of host byte order
+	EXPECT_INT(reader.GetByte(0), 0x01);
+	EXPECT_INT(reader.GetWord(0), 0x0201);
+	EXPECT_TRUE(reader.GetDWord(0) == 0x04030201);
+	EXPECT_TRUE(reader.GetQWord(0) == 0x0807060504030201ULL);
+	EXPECT_INT(reader.GetSWord(8), -2);
+	EXPECT_INT(reader.GetSByte(9), -1);
+	EXPECT_INT(reader.Get<uint16_t>(1), 0x0302);
+
+	// MemRange builds qwords of dwords, low one first
+	EXPECT_TRUE(buffer.GetQWord(0) == (((uint64_t)buffer.GetDWord(4) << 32) | buffer.GetDWord(0)));
+
+	EXPECT_TRUE(reader.HasString(10, "AB"));
+	EXPECT_TRUE(!reader.HasString(10, "AC"));
+	EXPECT_TRUE(reader.GetString(10, 2) == "AB");
+
+	// records are offset and checked as a whole
+	DataReader record = reader.GetRecord(8, 4);
+	EXPECT_INT(record.GetSize(), 4);
+	EXPECT_INT(record.GetWord(0), 0xfffe);
+	EXPECT_INT(reader.GetRecord(4).GetSize(), 8);
+	EXPECT_INT(reader.GetRecord(12, 0).GetSize(), 0);
+
+	EXPECT_TRUE(reader.HasRecord(0, 12));
+	EXPECT_TRUE(!reader.HasRecord(1, 12));
+	EXPECT_EXCEPTION(reader.GetRecord(10, 3), std::out_of_range);
+	EXPECT_EXCEPTION(reader.GetRecord(13), std::out_of_range);
+	EXPECT_EXCEPTION(reader.GetRecord(1, (size_t)-1), std::out_of_range);
+END_TEST()
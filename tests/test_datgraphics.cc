@@ -0,0 +1,106 @@
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dat/buffer.hh>
+#include <dat/datgraphics.hh>
+
+#include "testing.h"
+
+// Opaque graphics file with two sprites and two colors
+static Buffer MakeGraphics(size_t truncate = 0) {
+	Buffer sprites;
+	AppendString(sprites, "SPRITES ");
+	AppendLittleEndian(sprites, 2, 2);
+	AppendLittleEndian(sprites, 0, 2);
+	AppendLittleEndian(sprites, 0, 4);
+
+	// 2x1 sprite
+	AppendLittleEndian(sprites, 4, 2);
+	AppendLittleEndian(sprites, 3, 2);
+	AppendLittleEndian(sprites, 1, 2);
+	AppendLittleEndian(sprites, 2, 2);
+	AppendLittleEndian(sprites, 2, 2);
+	AppendLittleEndian(sprites, 1, 2);
+	AppendLittleEndian(sprites, 48, 4);
+
+	// 1x1 sprite
+	AppendLittleEndian(sprites, 1, 2);
+	AppendLittleEndian(sprites, 1, 2);
+	AppendLittleEndian(sprites, 0, 2);
+	AppendLittleEndian(sprites, 0, 2);
+	AppendLittleEndian(sprites, 1, 2);
+	AppendLittleEndian(sprites, 1, 2);
+	AppendLittleEndian(sprites, 50, 4);
+
+	static const unsigned char pixels[] = { 0, 1, 1 };
+	sprites.Append(pixels, sizeof(pixels));
+
+	Buffer graphics;
+	AppendString(graphics, "GRAPHICS");
+	AppendLittleEndian(graphics, 0, 2);
+	graphics.Append((unsigned char)0, 2);
+	AppendLittleEndian(graphics, sprites.GetSize(), 4);
+	graphics.Append((unsigned char)0, 16);
+	graphics.Append(sprites.GetData(), sprites.GetSize());
+
+	AppendString(graphics, "PALETTE ");
+	AppendLittleEndian(graphics, 2, 2);
+	graphics.Append((unsigned char)0, 22);
+	static const unsigned char colors[] = { 0x3f, 0x00, 0x00, 0x00, 0x00, 0x3f };
+	graphics.Append(colors, sizeof(colors));
+
+	Buffer result;
+	result.Append(graphics.GetData(), graphics.GetSize() - truncate);
+	return result;
+}
+
+BEGIN_TEST()
+	Buffer data = MakeGraphics();
+
+	EXPECT_TRUE(DatGraphics::IsGraphics(data));
+
+	DatGraphics graphics(data);
+	EXPECT_INT(graphics.GetNumSprites(), 2);
+	EXPECT_INT(graphics.GetFrameWidth(0), 4);
+	EXPECT_INT(graphics.GetFrameHeight(0), 3);
+	EXPECT_INT(graphics.GetXOffset(0), 1);
+	EXPECT_INT(graphics.GetYOffset(0), 2);
+	EXPECT_INT(graphics.GetWidth(0), 2);
+	EXPECT_INT(graphics.GetHeight(0), 1);
+	EXPECT_INT(graphics.GetWidth(1), 1);
+	EXPECT_EXCEPTION(graphics.GetWidth(2), std::out_of_range);
+
+	DatGraphics::Sprite sprite = graphics.GetSprite(0);
+	EXPECT_INT(sprite.framewidth, 4);
+	EXPECT_INT(sprite.yoffset, 2);
+	EXPECT_INT(sprite.width, 2);
+	EXPECT_INT(sprite.height, 1);
+	EXPECT_EXCEPTION(graphics.GetSprite(2), std::out_of_range);
+
+	// BGRA: first color is red, second is blue
+	std::vector<unsigned char> pixels = graphics.GetPixels(0);
+	EXPECT_INT(pixels.size(), 8);
+	EXPECT_INT(pixels[0], 0);
+	EXPECT_INT(pixels[2], 255);
+	EXPECT_INT(pixels[3], 255);
+	EXPECT_INT(pixels[4], 255);
+	EXPECT_INT(pixels[6], 0);
+
+	pixels = graphics.GetPixels(1);
+	EXPECT_INT(pixels.size(), 4);
+	EXPECT_INT(pixels[0], 255);
+
+	// invalid files are rejected by both probe and constructor
+	Buffer truncated = MakeGraphics(1);
+	EXPECT_TRUE(!DatGraphics::IsGraphics(truncated));
+	EXPECT_EXCEPTION(DatGraphics{truncated}, std::logic_error);
+
+	Buffer empty;
+	EXPECT_TRUE(!DatGraphics::IsGraphics(empty));
+	EXPECT_EXCEPTION(DatGraphics{empty}, std::logic_error);
+
+	Buffer notgraphics;
+	AppendString(notgraphics, "LEVEL DATA, NOT GRAPHICS AT ALL");
+	EXPECT_TRUE(!DatGraphics::IsGraphics(notgraphics));
+END_TEST()
@@ -0,0 +1,99 @@
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include <dat/buffer.hh>
+#include <dat/datlevel.hh>
+
+#include "testing.h"
+
+static Buffer MakeBuffer(const std::vector<unsigned short>& words) {
+	Buffer buffer;
+	for (auto& word : words)
+		AppendLittleEndian(buffer, word, 2);
+	return buffer;
+}
+
+static std::unique_ptr<MemRange> CopyImage(const MemRange& image, size_t size) {
+	std::unique_ptr<Buffer> copy(new Buffer);
+	copy->Append(image.GetData(), size);
+	return std::unique_ptr<MemRange>(std::move(copy));
+}
+
+BEGIN_TEST()
+	auto check_level = [&](const DatLevel& level) {
+		int num_buildings = 0;
+		level.ForeachBuildingInstance([&](const DatLevel::BuildingInstance& bi) {
+			EXPECT_INT(bi.type, 4);
+			EXPECT_INT(bi.x, 200);
+			EXPECT_INT(bi.y, 100);
+			EXPECT_INT(bi.sprite_x, 24);
+			EXPECT_INT(bi.sprite_y, -16);
+			EXPECT_INT(bi.dead_type, 0);
+			num_buildings++;
+		});
+		EXPECT_INT(num_buildings, 1);
+
+		int num_units = 0;
+		level.ForeachUnitInstance([&](const DatLevel::UnitInstance& ui) {
+			EXPECT_INT(ui.x, 400);
+			EXPECT_INT(ui.y, 300);
+			EXPECT_INT(ui.z, -5);
+			num_units++;
+		});
+		EXPECT_INT(num_units, 1);
+
+		const DatLevel::BuildingType& type = level.GetBuildingType(4);
+		EXPECT_INT(type.width, 32);
+		EXPECT_INT(type.height, 16);
+		EXPECT_INT(type.health, 100);
+		EXPECT_TRUE(type.resource_name == "HANGAR");
+		EXPECT_INT(type.blocks.size(), 2);
+		EXPECT_INT(type.blocks[0], 0x0001);
+		EXPECT_INT(type.blocks[1], 0x0102);
+		EXPECT_INT(type.bboxes.size(), 1);
+		EXPECT_INT(type.bboxes[0].y1, -1);
+		EXPECT_INT(type.bboxes[0].x2, 10);
+		EXPECT_INT(type.bboxes[0].z2, 20);
+
+		EXPECT_EXCEPTION(level.GetBuildingType(5), std::runtime_error);
+	};
+
+
+	// single 1x1 block level with one building and one unit
+	Buffer leveldata = MakeBuffer({
+		2, 1, 6,
+		4, (unsigned short)-2, 3, 100, 200, 0, 0, 0, 0, 0,
+		28, 1, 32,
+		0, 0, 0, 300, 400, (unsigned short)-5, 0, 0, 0, 0, 0,
+	});
+
+	Buffer thingsdata = MakeBuffer({
+		0, 0,
+		0xb024, 32, 16, 38, 0, 0, 100, 0, 0, 0, 1,
+		(unsigned short)-1, 0, 0, 10, 0, 20,
+		0x0001, 0x0102,
+	});
+
+	DatLevel level(leveldata, thingsdata, 1, 1, 0x123456789abcdefULL);
+	check_level(level);
+	EXPECT_TRUE(level.GetSourceChecksum() == 0x123456789abcdefULL);
+
+	const MemRange& image = level.GetImage();
+	EXPECT_INT(image.GetSize() % 8, 0);
+
+	// image may be used in place of parsed data
+	DatLevel cached(CopyImage(image, image.GetSize()), 1, 1);
+	check_level(cached);
+	EXPECT_TRUE(cached.GetSourceChecksum() == 0x123456789abcdefULL);
+
+	// invalid images are rejected
+	EXPECT_EXCEPTION(DatLevel(CopyImage(image, image.GetSize()), 2, 1), std::runtime_error);
+	EXPECT_EXCEPTION(DatLevel(CopyImage(image, image.GetSize() - 8), 1, 1), std::runtime_error);
+	EXPECT_EXCEPTION(DatLevel(CopyImage(image, 16), 1, 1), std::runtime_error);
+
+	std::unique_ptr<Buffer> badmagic(new Buffer);
+	badmagic->Append('X');
+	badmagic->Append(image.GetData() + 1, image.GetSize() - 1);
+	EXPECT_EXCEPTION(DatLevel(std::unique_ptr<MemRange>(std::move(badmagic)), 1, 1), std::runtime_error);
+END_TEST()
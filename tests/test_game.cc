@@ -0,0 +1,251 @@
+#include <set>
+#include <vector>
+#include <new>
+#include <cstdlib>
+#include <atomic>
+
+#include <game/game.hh>
+#include <game/gameobject.hh>
+#include <game/visitor.hh>
+
+#include "testing.h"
+
+// counts allocations, to check that updates in steady state do not allocate
+static std::atomic<size_t> num_allocations(0);
+
+void* operator new(size_t size) {
+	num_allocations++;
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+	std::free(ptr);
+}
+
+// Counts updates, spawns a child on first update, and
+// removes itself after given number of updates
+class TestObject : public GameObject {
+public:
+	int updates;
+	int lifetime;
+	bool spawn_child;
+
+	static int num_alive;
+
+public:
+	TestObject(Game& game, int l, bool s) : GameObject(game), updates(0), lifetime(l), spawn_child(s) {
+		num_alive++;
+	}
+
+	~TestObject() {
+		num_alive--;
+	}
+
+	virtual void Accept(Visitor& visitor) {
+		visitor.Visit(*this);
+	}
+
+	virtual void Update(unsigned int) {
+		if (updates++ == 0 && spawn_child)
+			game_.SpawnLater<TestObject>(1, false);
+		if (updates == lifetime)
+			RemoveLater();
+	}
+};
+
+int TestObject::num_alive = 0;
+
+// Logs its updates through deferred commands, and
+// spawns a child each time, until lifetime expires
+class LoggingObject : public GameObject {
+public:
+	int id;
+	int lifetime;
+	std::vector<int>* log;
+
+	static int num_alive;
+
+public:
+	LoggingObject(Game& game, int i, int l, std::vector<int>* lg) : GameObject(game), id(i), lifetime(l), log(lg) {
+		num_alive++;
+	}
+
+	~LoggingObject() {
+		num_alive--;
+	}
+
+	virtual void Accept(Visitor& visitor) {
+		visitor.Visit(*this);
+	}
+
+	virtual void Update(unsigned int) {
+		std::vector<int>* lg = log;
+		int i = id;
+		game_.Defer([lg, i]() { lg->push_back(i); });
+
+		if (--lifetime > 0)
+			game_.SpawnLater<LoggingObject>(id + 10000, lifetime, log);
+		RemoveLater();
+	}
+};
+
+int LoggingObject::num_alive = 0;
+
+// Spawns short living children and defers a command with
+// large capture on each update
+class SpawningObject : public GameObject {
+public:
+	long long* sum;
+
+public:
+	SpawningObject(Game& game, long long* s) : GameObject(game), sum(s) {
+	}
+
+	virtual void Accept(Visitor& visitor) {
+		visitor.Visit(*this);
+	}
+
+	virtual void Update(unsigned int deltams) {
+		for (int i = 0; i < 3; i++)
+			game_.SpawnLater<TestObject>(1, false);
+
+		long long* s = sum;
+		long long a = deltams, b = 2, c = 3, d = 4, e = 5;
+		game_.Defer([s, a, b, c, d, e]() { *s += a + b + c + d + e; });
+	}
+};
+
+class CollectingVisitor : public Visitor {
+public:
+	std::set<GameObject*> objects;
+
+	virtual void Visit(GameObject& object) {
+		objects.insert(&object);
+	}
+};
+
+static std::set<GameObject*> GetObjects(Game& game) {
+	CollectingVisitor visitor;
+	game.Accept(visitor);
+	return visitor.objects;
+}
+
+static int CountObjects(Game& game) {
+	return GetObjects(game).size();
+}
+
+BEGIN_TEST()
+	{
+		Game game(1000, 1000);
+
+		// enough objects to use several chunks
+		for (int i = 0; i < 1000; i++)
+			game.Spawn<TestObject>(i % 3 + 1, i % 10 == 0);
+
+		EXPECT_INT(CountObjects(game), 1000);
+
+		// children are visible, but not updated in the same tick
+		game.Update(10);
+		EXPECT_INT(CountObjects(game), 1000 - 334 + 100);
+		EXPECT_INT(TestObject::num_alive, 1000 - 334 + 100);
+
+		std::set<GameObject*> objects = GetObjects(game);
+
+		game.Update(10);
+		EXPECT_INT(CountObjects(game), 1000 - 667);
+
+		// freed slots are reused
+		EXPECT_TRUE(objects.find(game.Spawn<TestObject>(1, false)) != objects.end());
+
+		game.Update(10);
+		game.Update(10);
+		EXPECT_INT(CountObjects(game), 0);
+
+		// removal from outside
+		TestObject* object = game.Spawn<TestObject>(100, false);
+		game.RemoveLater(object);
+		EXPECT_INT(CountObjects(game), 0);
+
+		game.Spawn<TestObject>(100, false);
+	}
+
+	// remaining objects are destroyed with the game
+	EXPECT_INT(TestObject::num_alive, 0);
+
+	// results do not depend on number of threads
+	std::vector<int> logs[2];
+	for (int n = 0; n < 2; n++) {
+		Game game(1000, 1000);
+		game.SetNumThreads(n == 0 ? 1 : 4);
+
+		for (int i = 0; i < 2000; i++)
+			game.Spawn<LoggingObject>(i, i % 5 + 1, &logs[n]);
+
+		for (int tick = 0; tick < 6; tick++)
+			game.Update(10);
+
+		EXPECT_INT(CountObjects(game), 0);
+		EXPECT_INT(LoggingObject::num_alive, 0);
+	}
+
+	EXPECT_INT((int)logs[0].size(), 400 * (1 + 2 + 3 + 4 + 5));
+	EXPECT_TRUE(logs[0] == logs[1]);
+
+	{
+		Game game(1000, 1000);
+		game.SetTickLength(10);
+
+		TestObject* object = game.Spawn<TestObject>(1000, false);
+
+		// leftover time is carried over to next call
+		EXPECT_INT(game.Advance(25), 2);
+		EXPECT_FLOAT_IN_RANGE(game.GetInterpolation(), 0.49, 0.51);
+		EXPECT_INT(game.Advance(5), 1);
+		EXPECT_FLOAT_IN_RANGE(game.GetInterpolation(), 0.0, 0.0);
+		EXPECT_INT(game.Advance(9), 0);
+		EXPECT_INT(object->updates, 3);
+
+		// time which does not fit into max_ticks is dropped
+		EXPECT_INT(game.Advance(1000, 5), 5);
+		EXPECT_INT(object->updates, 8);
+		EXPECT_INT(game.Advance(0), 0);
+	}
+
+	{
+		// deferred commands and spawns do not allocate once
+		// buffers and pools have grown
+		long long sum = 0;
+		Game game(1000, 1000);
+		game.SetNumThreads(4);
+
+		for (int i = 0; i < 1000; i++)
+			game.Spawn<SpawningObject>(&sum);
+
+		for (int tick = 0; tick < 10; tick++)
+			game.Update(10);
+
+		size_t allocations_before = num_allocations;
+		for (int tick = 0; tick < 10; tick++)
+			game.Update(10);
+
+		EXPECT_INT((int)(num_allocations - allocations_before), 0);
+		EXPECT_TRUE(sum == 20 * 1000 * (10 + 2 + 3 + 4 + 5));
+	}
+
+	{
+		// generation identifies contents, not the object
+		Game game(1000, 1000);
+		Game other(1000, 1000);
+		EXPECT_TRUE(game.GetGeneration() != other.GetGeneration());
+
+		uint64_t other_generation = other.GetGeneration();
+		game = std::move(other);
+		EXPECT_TRUE(game.GetGeneration() == other_generation);
+	}
+END_TEST()
@@ -0,0 +1,95 @@
+#include <algorithm>
+
+#include <game/game.hh>
+#include <game/visitor.hh>
+
+#include <gameobjects/building.hh>
+#include <gameobjects/explosion.hh>
+#include <gameobjects/projectile.hh>
+#include <gameobjects/projectilesystem.hh>
+
+#include <math/pi.hh>
+
+#include "testing.h"
+
+class CountingVisitor : public Visitor {
+public:
+	int projectiles = 0;
+	int explosions[Explosion::BOOM + 1] = {};
+	float max_explosion_z = 0.0f;
+
+public:
+	void Visit(Projectile&) {
+		projectiles++;
+	}
+
+	void Visit(Explosion& explosion) {
+		explosions[explosion.GetType()]++;
+		max_explosion_z = std::max(max_explosion_z, explosion.GetPos().z);
+	}
+};
+
+BEGIN_TEST()
+	{
+		// rockets hit thin buildings even if they pass them in one tick
+		Game game(1024, 1024);
+		for (int i = 0; i < 50; i++) {
+			Building* building = game.Spawn<Building>(Vector3f(100 + i * 15, 300, 0), 1000, 1, Vector3f());
+			building->AddBBox(BBoxf(Vector3f(), -5, -1, 5, 1, 0, 20, -pi/4));
+		}
+
+		ProjectileSystem& system = game.GetSingleton<ProjectileSystem>();
+		for (int i = 0; i < 50; i++)
+			system.Add(Vector3f(100 + i * 15, 500, 10), Vector3f(), Direction3f(0, 0), Projectile::HYDRA);
+
+		EXPECT_TRUE(&game.GetSingleton<ProjectileSystem>() == &system);
+		EXPECT_INT(system.GetNumProjectiles(), 50);
+
+		for (int i = 0; i < 7; i++)
+			game.Update(100);
+
+		CountingVisitor visitor;
+		game.Accept(visitor);
+		EXPECT_INT(visitor.projectiles, 0);
+		EXPECT_INT(visitor.explosions[Explosion::HYDRA], 50);
+	}
+
+	{
+		// bullets fall to the ground and explode on it
+		Game game(1024, 1024);
+
+		ProjectileSystem& system = game.GetSingleton<ProjectileSystem>();
+		for (int i = 0; i < 10; i++)
+			system.Add(Vector3f(100 + i * 10, 1000, 10), Vector3f(), Direction3f(0, 0), Projectile::BULLET);
+
+		// position is interpolated between updates
+		game.Update(100);
+		{
+			Projectile projectile(system, 0);
+			EXPECT_FLOAT_IN_RANGE(projectile.GetInterpolatedPos(0.0f).y, 999.9f, 1000.1f);
+			EXPECT_FLOAT_IN_RANGE(projectile.GetInterpolatedPos(0.5f).y, 979.9f, 980.1f);
+			EXPECT_FLOAT_IN_RANGE(projectile.GetPos().y, 959.9f, 960.1f);
+		}
+
+		// stop before explosions end
+		for (int i = 0; i < 10 && system.GetNumProjectiles() > 0; i++)
+			game.Update(100);
+
+		CountingVisitor visitor;
+		game.Accept(visitor);
+		EXPECT_INT(visitor.projectiles, 0);
+		EXPECT_INT(visitor.explosions[Explosion::GUN_GROUND], 10);
+		EXPECT_FLOAT_IN_RANGE(visitor.max_explosion_z, -0.01f, 0.01f);
+	}
+
+	{
+		// outside of update, projectiles are added immediately
+		Game game(1024, 1024);
+
+		ProjectileSystem::SpawnLater(game, Vector3f(500, 500, 100), Vector3f(), Direction3f(0, 0), Projectile::HELLFIRE);
+
+		CountingVisitor visitor;
+		game.Accept(visitor);
+		EXPECT_INT(visitor.projectiles, 1);
+	}
+END_TEST()
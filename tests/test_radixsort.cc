@@ -0,0 +1,55 @@
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+#include <vector>
+
+#include <math/radixsort.hh>
+
+#include "testing.h"
+
+typedef std::pair<float, int> Item; // key and original position
+
+static bool IsSortedStable(const std::vector<Item>& items) {
+	std::vector<Item> expected = items;
+	std::sort(expected.begin(), expected.end());
+	return expected == items;
+}
+
+BEGIN_TEST()
+	// key order
+	EXPECT_TRUE(FloatToSortKey(-100.0f) < FloatToSortKey(-1.0f));
+	EXPECT_TRUE(FloatToSortKey(-1.0f) < FloatToSortKey(-0.5f));
+	EXPECT_TRUE(FloatToSortKey(-0.5f) < FloatToSortKey(0.0f));
+	EXPECT_TRUE(FloatToSortKey(0.0f) < FloatToSortKey(0.5f));
+	EXPECT_TRUE(FloatToSortKey(0.5f) < FloatToSortKey(1.0f));
+	EXPECT_TRUE(FloatToSortKey(1.0f) < FloatToSortKey(100.0f));
+
+	std::vector<Item> items;
+	std::vector<Item> scratch;
+	auto key = [](const Item& item) { return FloatToSortKey(item.first); };
+
+	// empty and single item
+	RadixSort(items, scratch, key);
+	EXPECT_TRUE(items.empty());
+
+	items.emplace_back(1.0f, 0);
+	RadixSort(items, scratch, key);
+	EXPECT_INT(items.size(), 1);
+
+	// random keys of both signs, with many duplicates
+	items.clear();
+	for (int i = 0; i < 10000; i++)
+		items.emplace_back((float)(std::rand() % 2000 - 1000) / 4.0f, i);
+
+	RadixSort(items, scratch, key);
+	EXPECT_INT(items.size(), 10000);
+	EXPECT_TRUE(IsSortedStable(items));
+
+	// storage is reused for the next sort
+	items.clear();
+	for (int i = 0; i < 1000; i++)
+		items.emplace_back(0.25f * (i % 7), i);
+
+	RadixSort(items, scratch, key);
+	EXPECT_TRUE(IsSortedStable(items));
+END_TEST()
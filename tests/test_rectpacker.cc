@@ -0,0 +1,102 @@
+#include <cstdlib>
+#include <vector>
+
+#include <graphics/rectpacker.hh>
+
+#include "testing.h"
+
+static bool Overlap(const RectPacker::Rect& a, const RectPacker::Rect& b, int padding) {
+	return a.page == b.page &&
+		a.x - padding < b.x + b.width + padding && b.x - padding < a.x + a.width + padding &&
+		a.y - padding < b.y + b.height + padding && b.y - padding < a.y + a.height + padding;
+}
+
+static bool Valid(const std::vector<RectPacker::Rect>& rects, int pagewidth, int pageheight, int padding) {
+	for (size_t i = 0; i < rects.size(); i++) {
+		const RectPacker::Rect& rect = rects[i];
+		if (rect.page < 0 || rect.x < padding || rect.y < padding || rect.x + rect.width + padding > pagewidth || rect.y + rect.height + padding > pageheight)
+			return false;
+		for (size_t j = 0; j < i; j++)
+			if (Overlap(rects[i], rects[j], padding))
+				return false;
+	}
+	return true;
+}
+
+BEGIN_TEST()
+	{
+		// fills page completely with equal rects
+		RectPacker packer(64, 64);
+		std::vector<RectPacker::Rect> rects;
+		for (int i = 0; i < 16; i++)
+			rects.push_back(packer.Place(16, 16));
+
+		EXPECT_TRUE(Valid(rects, 64, 64, 0));
+		EXPECT_INT(packer.GetNumPages(), 1);
+		EXPECT_FLOAT_IN_RANGE(packer.GetOccupancy(0), 0.999f, 1.001f);
+
+		// next one goes to a new page
+		EXPECT_INT(packer.Place(1, 1).page, 1);
+		EXPECT_INT(packer.GetNumPages(), 2);
+	}
+
+	{
+		// skipped pages are never used
+		RectPacker packer(64, 64);
+		packer.SkipPages(2);
+		EXPECT_INT(packer.Place(8, 8).page, 2);
+		EXPECT_FLOAT_IN_RANGE(packer.GetOccupancy(0), 0.999f, 1.001f);
+	}
+
+	{
+		// free space on early pages is found among many full ones
+		RectPacker packer(64, 64);
+		packer.Place(64, 60);
+		for (int i = 0; i < 40; i++)
+			packer.Place(64, 64);
+		EXPECT_INT(packer.GetNumPages(), 41);
+		packer.Place(48, 4);
+		EXPECT_INT(packer.Place(16, 4).page, 0);
+		EXPECT_INT(packer.Place(1, 1).page, 41);
+	}
+
+	{
+		// too large
+		RectPacker packer(64, 64);
+		EXPECT_EXCEPTION(packer.Place(65, 1), std::logic_error);
+		EXPECT_EXCEPTION(packer.Place(63, 63, 1), std::logic_error);
+	}
+
+	{
+		// random rects, one by one and in batch
+		std::vector<RectPacker::Size> sizes;
+		for (int i = 0; i < 1000; i++)
+			sizes.emplace_back(std::rand() % 48 + 1, std::rand() % 48 + 1);
+
+		RectPacker single(256, 256);
+		std::vector<RectPacker::Rect> single_rects;
+		for (auto& size : sizes)
+			single_rects.push_back(single.Place(size.width, size.height, 1));
+
+		EXPECT_TRUE(Valid(single_rects, 256, 256, 1));
+
+		RectPacker batch(256, 256);
+		std::vector<RectPacker::Rect> batch_rects = batch.Place(sizes, 1);
+
+		EXPECT_TRUE(batch_rects.size() == sizes.size());
+		EXPECT_TRUE(Valid(batch_rects, 256, 256, 1));
+
+		bool sizes_match = true;
+		for (size_t i = 0; i < sizes.size(); i++)
+			if (batch_rects[i].width != sizes[i].width || batch_rects[i].height != sizes[i].height)
+				sizes_match = false;
+		EXPECT_TRUE(sizes_match);
+
+		// batch packs tighter
+		EXPECT_TRUE(batch.GetNumPages() <= single.GetNumPages());
+
+		// all pages but last are well filled
+		for (int page = 0; page < batch.GetNumPages() - 1; page++)
+			EXPECT_TRUE(batch.GetOccupancy(page) > 0.8f);
+	}
+END_TEST()
@@ -0,0 +1,47 @@
+#include <vector>
+#include <set>
+
+#include <math/spatialgrid.hh>
+
+#include "testing.h"
+
+static std::multiset<int> Query(const SpatialGrid<int>& grid, const Vector2f& min, const Vector2f& max) {
+	std::multiset<int> found;
+	grid.ForeachInArea(min, max, [&found](int& object) { found.insert(object); });
+	return found;
+}
+
+BEGIN_TEST()
+	SpatialGrid<int> grid(1000, 1000, 100);
+
+	std::vector<int> objects = { 0, 1, 2, 3 };
+
+	grid.Insert(&objects[0], Vector2f(10, 10), Vector2f(20, 20));     // single cell
+	grid.Insert(&objects[1], Vector2f(50, 50), Vector2f(450, 250));   // many cells
+	grid.Insert(&objects[2], Vector2f(-50, 900), Vector2f(-10, 950)); // outside of the grid
+	grid.Insert(&objects[3], Vector2f(990, 990), Vector2f(1200, 1200));
+
+	// each object is reported once
+	EXPECT_TRUE(Query(grid, Vector2f(-1000, -1000), Vector2f(2000, 2000)) == std::multiset<int>({ 0, 1, 2, 3 }));
+	EXPECT_TRUE(Query(grid, Vector2f(0, 0), Vector2f(500, 500)) == std::multiset<int>({ 0, 1 }));
+	EXPECT_TRUE(Query(grid, Vector2f(300, 200), Vector2f(700, 700)) == std::multiset<int>({ 1 }));
+
+	// objects which share cells with the area, but do not intersect it
+	EXPECT_TRUE(Query(grid, Vector2f(25, 25), Vector2f(45, 45)) == std::multiset<int>());
+	EXPECT_TRUE(Query(grid, Vector2f(0, 920), Vector2f(50, 930)) == std::multiset<int>());
+
+	// point queries
+	EXPECT_TRUE(Query(grid, Vector2f(15, 15), Vector2f(15, 15)) == std::multiset<int>({ 0 }));
+	EXPECT_TRUE(Query(grid, Vector2f(-20, 920), Vector2f(-20, 920)) == std::multiset<int>({ 2 }));
+	EXPECT_TRUE(Query(grid, Vector2f(1100, 1100), Vector2f(1100, 1100)) == std::multiset<int>({ 3 }));
+
+	// update and removal
+	grid.Insert(&objects[0], Vector2f(610, 610), Vector2f(620, 620));
+	EXPECT_TRUE(Query(grid, Vector2f(0, 0), Vector2f(100, 100)) == std::multiset<int>({ 1 }));
+	EXPECT_TRUE(Query(grid, Vector2f(600, 600), Vector2f(700, 700)) == std::multiset<int>({ 0 }));
+
+	grid.Remove(&objects[1]);
+	grid.Remove(&objects[1]);
+	EXPECT_TRUE(Query(grid, Vector2f(0, 0), Vector2f(500, 500)) == std::multiset<int>());
+	EXPECT_TRUE(!grid.IsEmpty());
+END_TEST()
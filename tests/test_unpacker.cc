@@ -0,0 +1,117 @@
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <dat/buffer.hh>
+#include <dat/unpacker.hh>
+
+#include "testing.h"
+
+class VectorRange : public MemRange {
+protected:
+	std::vector<unsigned char> data_;
+
+public:
+	VectorRange(std::initializer_list<unsigned char> data) : data_(data) {}
+
+	virtual const unsigned char* GetData() const { return data_.data(); }
+	virtual size_t GetSize() const { return data_.size(); }
+};
+
+std::string Unpack(const MemRange& in, Unpacker::Mode mode) {
+	Buffer out;
+	Unpacker(mode).Process(in, out);
+	return std::string(reinterpret_cast<const char*>(out.GetData()), out.GetSize());
+}
+
+// feeds input and takes output in pieces of given sizes
+std::string UnpackStreaming(const MemRange& in, Unpacker::Mode mode, size_t in_piece, size_t out_piece) {
+	Unpacker unpacker(mode);
+	std::string out;
+	std::vector<unsigned char> piece(out_piece);
+
+	size_t offset = 0;
+	while (offset < in.GetSize() && !unpacker.IsFinished()) {
+		offset += unpacker.Push(in.GetData() + offset, std::min(in_piece, in.GetSize() - offset));
+
+		size_t size;
+		while ((size = unpacker.Pull(piece.data(), piece.size())) > 0)
+			out.append(reinterpret_cast<const char*>(piece.data()), size);
+	}
+
+	if (!unpacker.IsFinished())
+		throw std::logic_error("unexpected end of data");
+
+	return out;
+}
+
+BEGIN_TEST()
+	// no table: literal run, short rle, end of data
+	VectorRange raw = { 0x00, 0x00, 0x03, 'a', 'b', 'c', 0x85, 'x', 0x00 };
+	EXPECT_STRING(Unpack(raw, Unpacker::RECURSIVE), "abcxxxxx");
+	EXPECT_STRING(Unpack(raw, Unpacker::EXPANDED), "abcxxxxx");
+
+	// long literal run and long rle
+	VectorRange longruns = { 0x00, 0x00, 0x40, 0x02, 'a', 'b', 0xc1, 0x00, 'z', 0x00 };
+	EXPECT_INT(Unpack(longruns, Unpacker::RECURSIVE).size(), 2 + 256);
+	EXPECT_STRING(Unpack(longruns, Unpacker::EXPANDED), Unpack(longruns, Unpacker::RECURSIVE));
+
+	// nested pairs: 0x10 -> "ab", 0x11 -> 0x10 0x10; 0xff is escape
+	VectorRange nested = {
+		0x02, 0xff,
+		0x10, 'a', 'b',
+		0x11, 0x10, 0x10,
+		0x07, 0x11, 0x10, 0xff, 0x10, 0x00
+	};
+	EXPECT_STRING(Unpack(nested, Unpacker::RECURSIVE), "ababab\x10");
+	EXPECT_STRING(Unpack(nested, Unpacker::EXPANDED), "ababab\x10");
+
+	// pair expands into control codes; pair redefined after being
+	// referenced; table is replaced in the middle of the data
+	VectorRange control = {
+		0x03, 0xfe,
+		0x20, 0x02, 'q',
+		0x21, 0x20, 0x03,
+		0x20, 0x84, 's',
+		0x21, 'x', 'y', 'z', 0x80,
+		0x01, 0xfd,
+		0x30, 0x82, 'z',
+		0x30, 0x00
+	};
+	EXPECT_STRING(Unpack(control, Unpacker::RECURSIVE), "ssssxyzzz");
+	EXPECT_STRING(Unpack(control, Unpacker::EXPANDED), "ssssxyzzz");
+
+	// zero length literal run never ends
+	VectorRange endless = { 0x00, 0x00, 0x40, 0x00, 'a', 'b', 0x00 };
+	EXPECT_EXCEPTION(Unpack(endless, Unpacker::RECURSIVE), std::logic_error);
+	EXPECT_EXCEPTION(Unpack(endless, Unpacker::EXPANDED), std::logic_error);
+
+	// truncated data
+	VectorRange truncated = { 0x00, 0x00, 0x05, 'a', 'b' };
+	EXPECT_EXCEPTION(Unpack(truncated, Unpacker::RECURSIVE), std::logic_error);
+	EXPECT_EXCEPTION(Unpack(truncated, Unpacker::EXPANDED), std::logic_error);
+
+	// streaming gives the same results for any piece sizes
+	for (auto mode : { Unpacker::RECURSIVE, Unpacker::EXPANDED }) {
+		for (const VectorRange* data : { &raw, &longruns, &nested, &control }) {
+			EXPECT_STRING(UnpackStreaming(*data, mode, 1, 1), Unpack(*data, mode));
+			EXPECT_STRING(UnpackStreaming(*data, mode, 3, 2), Unpack(*data, mode));
+			EXPECT_STRING(UnpackStreaming(*data, mode, 1024, 1024), Unpack(*data, mode));
+		}
+
+		EXPECT_EXCEPTION(UnpackStreaming(truncated, mode, 2, 2), std::logic_error);
+	}
+
+	// output much larger than input is pulled in parts
+	Buffer large;
+	large.Append((unsigned char)0, 2);
+	for (int i = 0; i < 100; i++) {
+		large.Append(0xff); // 16383 times
+		large.Append(0xff);
+		large.Append('a' + i % 26);
+	}
+	large.Append(0);
+	EXPECT_INT(UnpackStreaming(large, Unpacker::EXPANDED, 7, 1000).size(), 100 * 16383);
+	EXPECT_STRING(UnpackStreaming(large, Unpacker::EXPANDED, 7, 1000), Unpack(large, Unpacker::EXPANDED));
+END_TEST()
@@ -0,0 +1,41 @@
+#include <vector>
+#include <atomic>
+#include <stdexcept>
+
+#include <game/workerpool.hh>
+
+#include "testing.h"
+
+BEGIN_TEST()
+	for (size_t num_threads : { 0, 1, 3 }) {
+		WorkerPool pool(num_threads);
+
+		// each item is processed once, pool is reusable
+		for (int run = 0; run < 3; run++) {
+			std::vector<int> processed(1000, 0);
+			pool.Run(processed.size(), [&processed](size_t item) { processed[item]++; });
+			EXPECT_TRUE(processed == std::vector<int>(1000, 1));
+		}
+
+		// progress is reported from calling thread, the last time
+		// after all items are finished
+		std::atomic<int> finished(0);
+		int reports = 0, last_report = -1;
+		pool.Run(100, [&finished](size_t) { finished++; }, [&finished, &reports, &last_report]() {
+			reports++;
+			last_report = finished;
+		});
+		EXPECT_TRUE(reports > 0);
+		EXPECT_INT(last_report, 100);
+
+		// errors are rethrown in both modes
+		EXPECT_EXCEPTION(pool.Run(100, [](size_t item) { if (item == 50) throw std::runtime_error("job"); }), std::runtime_error);
+		EXPECT_EXCEPTION(pool.Run(100, [](size_t item) { if (item == 50) throw std::runtime_error("job"); }, []() {}), std::runtime_error);
+		EXPECT_EXCEPTION(pool.Run(100, [](size_t) {}, []() { throw std::runtime_error("progress"); }), std::runtime_error);
+
+		// and pool is usable after them
+		std::atomic<int> count(0);
+		pool.Run(10, [&count](size_t) { count++; });
+		EXPECT_INT(count, 10);
+	}
+END_TEST()
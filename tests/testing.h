@@ -30,8 +30,11 @@
 #ifndef TESTING_H_INCLUDED
 #define TESTING_H_INCLUDED
 
+#include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <exception>
+#include <string>
 
 // Define NO_TEST_COLOR before including testing.h to disable colors
 #ifndef NO_TEST_COLOR
@@ -137,4 +140,18 @@
 		} \
 	}
 
+// Binary data builders; work with any buffer type which has
+// Append(unsigned char)
+template<class T>
+void AppendLittleEndian(T& buffer, uint64_t value, size_t size) {
+	for (size_t i = 0; i < size; i++)
+		buffer.Append(static_cast<unsigned char>(value >> (i * 8)));
+}
+
+template<class T>
+void AppendString(T& buffer, const std::string& string) {
+	for (char c : string)
+		buffer.Append(static_cast<unsigned char>(c));
+}
+
 #endif // TESTING_H_INCLUDED
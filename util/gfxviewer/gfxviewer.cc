@@ -40,12 +40,7 @@ int FindNextGraphics(DatFile& datfile, int current = 0, bool forward = true) {
 		if (next == current)
 			throw std::runtime_error("no graphics found in data file");
 
-		found = true;
-		try {
-			DatGraphics gr(datfile.GetData(next));
-		} catch (...) {
-			found = false;
-		}
+		found = DatGraphics::IsGraphics(*datfile.GetData(next));
 	} while (!found);
 
 	return next;
@@ -62,6 +57,7 @@ int realmain(int argc, char** argv) {
 	}
 
 	DatFile datfile(argv[1]);
+	datfile.SetCacheLimit(16 * 1024 * 1024); // entries are revisited when browsing
 	int current_graphics = FindNextGraphics(datfile);
 	int zoom = 2;
 
@@ -75,22 +71,24 @@ int realmain(int argc, char** argv) {
 		std::cerr << "Displaying " << datfile.GetName(current_graphics) << "..." << std::endl;
 		window.SetTitle(std::string("OpenStrike Sprite Viewer [") + datfile.GetName(current_graphics) + "]");
 
-		Buffer graphics_data = datfile.GetData(current_graphics);
-		DatGraphics graphics(graphics_data);
+		std::shared_ptr<const Buffer> graphics_data = datfile.GetData(current_graphics);
+		DatGraphics graphics(*graphics_data);
 
 		render.SetDrawColor(0, 32, 32);
 		render.Clear();
 
 		int x = 0, y = 0, maxheight = 0;
 		for (unsigned int i = 0; i < graphics.GetNumSprites(); ++i) {
-			if (graphics.GetWidth(i) == 0 || graphics.GetHeight(i) == 0)
+			DatGraphics::Sprite sprite = graphics.GetSprite(i);
+
+			if (sprite.width == 0 || sprite.height == 0)
 				continue;
 
-			SDL2pp::Texture tex(render, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, graphics.GetWidth(i), graphics.GetHeight(i));
-			tex.Update(SDL2pp::NullOpt, graphics.GetPixels(i).data(), graphics.GetWidth(i) * 4);
+			SDL2pp::Texture tex(render, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STATIC, sprite.width, sprite.height);
+			tex.Update(SDL2pp::NullOpt, graphics.GetPixels(i).data(), sprite.width * 4);
 			tex.SetBlendMode(SDL_BLENDMODE_BLEND);
 
-			if (x + graphics.GetFrameWidth(i) * zoom > window.GetWidth()) {
+			if (x + sprite.framewidth * zoom > window.GetWidth()) {
 				x = 0;
 				y += maxheight;
 				maxheight = 0;
@@ -100,27 +98,27 @@ int realmain(int argc, char** argv) {
 			render.DrawRect(SDL2pp::Rect(
 						x,
 						y,
-						graphics.GetFrameWidth(i) * zoom,
-						graphics.GetFrameHeight(i) * zoom
+						sprite.framewidth * zoom,
+						sprite.frameheight * zoom
 					));
 
 			render.SetDrawColor(255, 255, 255, 32);
 			render.DrawRect(SDL2pp::Rect(
-						x + graphics.GetXOffset(i) * zoom,
-						y + graphics.GetYOffset(i) * zoom,
-						graphics.GetWidth(i) * zoom,
-						graphics.GetHeight(i) * zoom
+						x + sprite.xoffset * zoom,
+						y + sprite.yoffset * zoom,
+						sprite.width * zoom,
+						sprite.height * zoom
 					));
 
 			render.Copy(tex, SDL2pp::NullOpt, SDL2pp::Rect(
-						x + graphics.GetXOffset(i) * zoom,
-						y + graphics.GetYOffset(i) * zoom,
-						graphics.GetWidth(i) * zoom,
-						graphics.GetHeight(i) * zoom
+						x + sprite.xoffset * zoom,
+						y + sprite.yoffset * zoom,
+						sprite.width * zoom,
+						sprite.height * zoom
 					));
 
-			maxheight = std::max(maxheight, graphics.GetFrameHeight(i) * zoom);
-			x += graphics.GetFrameWidth(i) * zoom;
+			maxheight = std::max(maxheight, sprite.frameheight * zoom);
+			x += sprite.framewidth * zoom;
 		}
 
 		render.Present();
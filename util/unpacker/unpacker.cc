@@ -17,30 +17,79 @@
  * along with openstrike.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <atomic>
+#include <cstdio>
+#include <fstream>
 #include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
 
 #include <getopt.h>
 
 #include <dat/datfile.hh>
 
+// unpacked sizes in datfile toc are multiples of this
+static const size_t paragraph_size = 16;
+
 void usage(const char* progname) {
-	std::cerr << "Usage: " << progname << " [-hlx] <filename.dat>" << std::endl;
+	std::cerr << "Usage: " << progname << " [-hltx] [-j jobs] <filename.dat>" << std::endl;
 	std::cerr << std::endl;
 	std::cerr << "    -l    List datfile entries" << std::endl;
 	std::cerr << "    -x    Extract data files into current durectory" << std::endl;
+	std::cerr << "    -t    Test datfile entries by unpacking them" << std::endl;
+	std::cerr << "    -j    Number of entries to unpack in parallel (default 1)" << std::endl;
 	std::cerr << "    -h    Display this help" << std::endl;
 	std::cerr << std::endl;
 }
 
+// Calls func for each entry from given number of threads,
+// returns error messages (empty for successful entries)
+template<class F>
+std::vector<std::string> ForEachEntry(int count, int jobs, const F& func) {
+	std::vector<std::string> errors(count);
+	std::atomic<int> next(0);
+
+	auto worker = [count, &func, &errors, &next]() {
+		int i;
+		while ((i = next++) < count) {
+			try {
+				func(i);
+			} catch (std::exception& e) {
+				errors[i] = e.what();
+			}
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for (int i = 1; i < jobs && i < count; i++)
+		threads.emplace_back(worker);
+
+	worker();
+
+	for (auto& thread : threads)
+		thread.join();
+
+	return errors;
+}
+
 int realmain(int argc, char** argv) {
 	int c;
-	bool dolist = false, doextract = false;
+	bool dolist = false, doextract = false, dotest = false;
+	int jobs = 1;
 	const char* progname = argv[0];
 
-	while ((c = getopt(argc, argv, "lxh")) != -1) {
+	while ((c = getopt(argc, argv, "lxtj:h")) != -1) {
 		switch (c) {
 		case 'l': dolist = true; break;
 		case 'x': doextract = true; break;
+		case 't': dotest = true; break;
+		case 'j':
+			jobs = std::stoi(optarg);
+			if (jobs < 1)
+				throw std::invalid_argument("number of jobs must be positive");
+			break;
 		case 'h': usage(progname); return 0;
 		default:  usage(progname); return 1;
 		}
@@ -49,27 +98,79 @@ int realmain(int argc, char** argv) {
 	argc -= optind;
 	argv += optind;
 
-	if (argc != 1 || (!dolist && !doextract)) {
+	if (argc != 1 || (!dolist && !doextract && !dotest)) {
 		usage(progname);
 		return 1;
 	}
 
-	DatFile datfile(argv[0]);
+	// mapping allows threads to read packed data without
+	// contending for a single stream
+	DatFile datfile(argv[0], DatFile::MMAP);
 
-	if (dolist)
+	// listing only needs table of contents
+	if (dolist) {
 		std::cerr << datfile.GetCount() << " entries" << std::endl;
+		for (int i = 0; i < datfile.GetCount(); i++)
+			std::cout << "Entry #" << i << " \"" << datfile.GetName(i) << "\", " << datfile.GetPackedSize(i) << " bytes packed, up to " << datfile.GetUnpackedSizeHint(i) << " bytes unpacked" << std::endl;
+	}
+
+	if (!doextract && !dotest)
+		return 0;
+
+	// entries are unpacked in chunks, so memory use does not
+	// depend on entry sizes; chunks are large enough to be
+	// written through without extra copying into stream buffer.
+	// Extracted entries are written to temporary files first, so
+	// failed entry never leaves truncated file behind
+	std::vector<std::string> errors = ForEachEntry(datfile.GetCount(), jobs, [&datfile, doextract](int i) {
+		std::string path = datfile.GetName(i);
+		std::string temp_path = path + ".tmp";
+
+		std::ofstream of;
+		if (doextract)
+			of.open(temp_path, std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+
+		try {
+			size_t unpacked_size = 0;
+			datfile.StreamData(i, [&of, &unpacked_size, doextract](const unsigned char* data, size_t size) {
+				unpacked_size += size;
+				if (doextract)
+					of.write(reinterpret_cast<const char*>(data), size);
+			});
 
+			// toc records unpacked size rounded up to whole paragraphs
+			size_t recorded_size = datfile.GetUnpackedSizeHint(i);
+			if ((unpacked_size + paragraph_size - 1) / paragraph_size * paragraph_size != recorded_size)
+				throw std::runtime_error("unpacked size " + std::to_string(unpacked_size) + " does not match size " + std::to_string(recorded_size) + " from toc");
+
+			if (doextract) {
+				if (!of.flush())
+					throw std::runtime_error("cannot write " + temp_path);
+				of.close();
+				if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+					throw std::runtime_error("cannot rename " + temp_path + " to " + path);
+			}
+		} catch (...) {
+			if (doextract) {
+				of.close();
+				std::remove(temp_path.c_str());
+			}
+			throw;
+		}
+	});
+
+	int num_errors = 0;
 	for (int i = 0; i < datfile.GetCount(); i++) {
-		Buffer unpacked = datfile.GetData(i);
-		if (dolist)
-			std::cout << "Entry #" << i << " \"" << datfile.GetName(i) << "\", " << unpacked.GetSize() << " bytes" << std::endl;
-		if (doextract) {
-			std::ofstream of(datfile.GetName(i), std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
-			of.write(reinterpret_cast<const char*>(unpacked.GetData()), unpacked.GetSize());
+		if (!errors[i].empty()) {
+			std::cerr << "Entry #" << i << " \"" << datfile.GetName(i) << "\": " << errors[i] << std::endl;
+			num_errors++;
 		}
 	}
 
-	return 0;
+	if (dotest)
+		std::cerr << datfile.GetCount() - num_errors << " of " << datfile.GetCount() << " entries OK" << std::endl;
+
+	return num_errors > 0 ? 1 : 0;
 }
 
 int main(int argc, char** argv) {